@@ -11,12 +11,109 @@ using namespace std;
 #define EOSIO eosio::name("eosio")
 #define CONTRACTN eosio::name("clashdometrn")
 
+// instrumented builds (-DCLASHDOME_INSTRUMENT=ON) count the table work done by each action 
+// and log it with a logstats inline action when the action ends. Read-only queries don't set 
+// INSTRUMENT_ACTION, read-only execution rejects the inline action
+#ifdef CLASHDOME_INSTRUMENT
+#define INSTRUMENT_ACTION(action_name) stats.action = eosio::name(action_name)
+#define INSTRUMENT_OP(table_name, counter) stats.of(eosio::name(table_name)).counter++
+#define INSTRUMENT_WRITE(table_name, counter, row) stats.write(eosio::name(table_name), &table_stats::counter, eosio::pack_size(row))
+#define INSTRUMENT_INLINE() stats.inline_actions++
+#else
+#define INSTRUMENT_ACTION(action_name)
+#define INSTRUMENT_OP(table_name, counter)
+#define INSTRUMENT_WRITE(table_name, counter, row)
+#define INSTRUMENT_INLINE()
+#endif
+
 CONTRACT clashdometrn : public contract {
 
    public:
 
       using contract::contract;
 
+      ~clashdometrn();
+
+      // tournament parameters as given by its creator
+      struct tournament_spec {
+         string name;
+         uint64_t game;
+         uint64_t timestamp_start;
+         uint64_t timestamp_end;
+         asset requeriment_fee;
+         asset requeriment_stake;
+         string requeriment_nft;
+         asset prize_pot;
+         string type_prize_pot;
+         bool recreate;
+      };
+
+      // query results
+      struct trn_summary {
+         uint64_t tournament_id;
+         eosio::name creator;
+         string name;
+         uint8_t game;
+         uint8_t phase; // TournamentPhase
+         uint32_t timestamp_start;
+         uint32_t timestamp_end;
+         asset prize_pot;
+         uint8_t type_prize_pot;
+         std::optional <asset> requeriment_fee;
+      };
+
+      // pass next_cursor back as cursor to get the following page, 0 when there are no more rows. 
+      // Cursors are index positions, so pages resume in place when rows are erased between calls
+      struct trn_page {
+         vector <trn_summary> tournaments;
+         uint128_t next_cursor;
+      };
+
+      struct creator_info {
+         name creator;
+         string img;
+         bool stake_available;
+         bool nft_available;
+         bool pot_available;
+         vector <asset> funds;
+         vector <extended_symbol> supported_tokens_fee;
+         vector <extended_symbol> supported_tokens_stake;
+      };
+
+      // work done by an action in a table, logged by instrumented builds
+      struct table_stats {
+         name table;
+         uint32_t finds;
+         uint32_t steps;
+         uint32_t emplaces;
+         uint32_t modifies;
+         uint32_t erases;
+         uint32_t bytes; // serialized by emplaces and modifies
+      };
+
+      // compact record of a pruned tournament, logged for indexers
+      struct archived_tournament {
+         uint64_t tournament_id;
+         name creator;
+         uint64_t game;
+         uint64_t timestamp_start;
+         uint64_t timestamp_end;
+         asset prize_pot;
+      };
+
+      // legacy supported token left out by migratetkns, its symbol is registered in the scope from another contract
+      struct skipped_token {
+         name scope;
+         extended_symbol token;
+         uint8_t type; // TOKEN_FEE | TOKEN_STAKE
+      };
+
+      // legacy NFT requirement left out by migratetrn, it can't be parsed as collection[:schema[:template_id[:count]]]
+      struct dropped_nft {
+         uint64_t tournament_id;
+         string requeriment_nft;
+      };
+
       ACTION initconfig();
 
       ACTION removeconfig();
@@ -27,6 +124,24 @@ CONTRACT clashdometrn : public contract {
          string type
       );
 
+      ACTION migratetkns(
+         uint64_t max_rows
+      );
+
+      ACTION migratefnds(
+         uint64_t max_rows
+      );
+
+      ACTION migratetrn(
+         uint64_t max_rows
+      );
+
+#ifdef CLASHDOME_GAME_SCOPES
+      ACTION migratescope(
+         uint64_t max_rows
+      );
+#endif
+
       ACTION createtrn(
          name creator,
          string name,
@@ -41,6 +156,11 @@ CONTRACT clashdometrn : public contract {
          bool recreate
       );
 
+      ACTION createtrns(
+         name creator,
+         vector <tournament_spec> specs
+      );
+
       ACTION edittrn(
          uint64_t id,
          name creator,
@@ -66,6 +186,49 @@ CONTRACT clashdometrn : public contract {
          uint64_t tournament_id
       );
 
+      ACTION prunetrn(
+         uint64_t max_rows
+      );
+
+      ACTION rollover(
+         uint64_t max_rows
+      );
+
+      ACTION submitscores(
+         uint64_t tournament_id,
+         vector <std::pair <name, uint64_t>> scores
+      );
+
+      ACTION payout(
+         uint64_t tournament_id,
+         uint64_t max_winners
+      );
+
+      ACTION commitres(
+         uint64_t tournament_id,
+         checksum256 merkle_root,
+         asset total_payout
+      );
+
+      ACTION claim(
+         uint64_t tournament_id,
+         uint32_t round_start,
+         name account,
+         asset amount,
+         uint32_t index,
+         vector <checksum256> proof
+      );
+
+      ACTION pruneentries(
+         uint64_t tournament_id,
+         uint64_t max_rows
+      );
+
+      ACTION pruneresults(
+         uint64_t tournament_id,
+         uint64_t max_rows
+      );
+
       ACTION rmusertrn(
          name creator,
          name account,
@@ -73,6 +236,18 @@ CONTRACT clashdometrn : public contract {
          string type
       );
 
+      ACTION rmusertrns(
+         name creator,
+         uint64_t tournament_id,
+         vector <name> accounts,
+         string type
+      );
+
+      ACTION prunemodlog(
+         uint64_t tournament_id,
+         uint64_t max_rows
+      );
+
       ACTION addcreator(
          name creator,
          string img,
@@ -92,11 +267,44 @@ CONTRACT clashdometrn : public contract {
          name creator
       );
 
+      ACTION purgecreator(
+         name creator,
+         uint64_t max_rows
+      );
+
       ACTION addtrnfunds(
          asset quantity,
          name contract
       );
 
+      ACTION setsweep(
+         extended_symbol token,
+         asset threshold
+      );
+
+      ACTION sweep(
+         extended_symbol token,
+         asset max_quantity
+      );
+
+      [[eosio::action, eosio::read_only]] trn_page listupcoming(
+         uint64_t game,
+         uint64_t from_ts,
+         uint64_t limit,
+         uint128_t cursor
+      );
+
+      [[eosio::action, eosio::read_only]] trn_page listbycr(
+         name creator,
+         uint8_t status,
+         uint64_t limit,
+         uint128_t cursor
+      );
+
+      [[eosio::action, eosio::read_only]] creator_info getcreator(
+         name creator
+      );
+
       ACTION logcreatetrn(
          uint64_t tournament_id, 
          name creator,
@@ -112,29 +320,122 @@ CONTRACT clashdometrn : public contract {
          bool recreate
       );
 
+      ACTION logprunetrn(
+         vector <archived_tournament> tournaments
+      );
+
+      ACTION logtknskip(
+         vector <skipped_token> tokens
+      );
+
+      ACTION lognftdrop(
+         vector <dropped_nft> requirements
+      );
+
+      ACTION logstats(
+         name action,
+         vector <table_stats> tables,
+         uint32_t inline_actions
+      );
+
       [[eosio::on_notify("atomicassets::transfer")]] void receive_nft(
         name from,
         name to,
-        vector <uint64_t> asset_ids,
-        string memo
+        const vector <uint64_t>& asset_ids,
+        const string& memo
       );
 
       [[eosio::on_notify("*::transfer")]] void receive_transfer(
         name from,
         name to,
-        asset quantity,
-        string memo
+        const asset& quantity,
+        const string& memo
       );
 
    private:
 
       // TABLES 
 
-      // tournaments
+      // nft requirement compiled from "collection[:schema[:template_id[:count]]]", "*" matches any schema or template
+      struct nft_requirement {
+         name collection;
+         name schema; // empty for any schema
+         int32_t template_id; // -1 for any template
+         uint8_t count;
+
+         bool matches(name other_collection, name other_schema, int32_t other_template_id) const {
+            return collection == other_collection && (schema == name() || schema == other_schema) && (template_id < 0 || template_id == other_template_id);
+         }
+      };
+
+      // state of the current round of a tournament, pot is the prize pot after applying the entry fees
+      struct round_state {
+         uint32_t entries;
+         asset collected;
+         asset pot;
+         uint32_t ranked; // rows in the leaderboard
+         uint8_t status; // RoundStatus
+         uint32_t winners; // ranked rows when the payout started
+         uint32_t paid; // winners paid so far, the payout cursor
+         asset distributed;
+      };
+
+      // tournaments, compact layout
       TABLE tournaments_s {
         
          uint64_t tournament_id;
-         name creator;
+         eosio::name creator;
+         string name;
+         uint8_t version = TOURNAMENT_VERSION;
+         uint8_t game;
+         uint8_t type_prize_pot; // PotType
+         bool recreate;
+         uint32_t timestamp_start; 
+         uint32_t timestamp_end;
+         asset prize_pot;
+         std::optional <asset> requeriment_fee; // only set when the amount isn't zero
+         std::optional <asset> requeriment_stake; // only set when the amount isn't zero
+         std::optional <nft_requirement> requeriment_nft;
+         eosio::binary_extension <round_state> round; // absent on rows written before pot_contract until the first entry or score
+         eosio::binary_extension <uint64_t> name_ref; // interned name, name is empty then. Rows with it always store round
+         eosio::binary_extension <eosio::name> pot_contract; // contract of the prize pot and fee tokens. Rows with it always store name_ref
+
+         uint64_t primary_key() const { return tournament_id; }
+         uint128_t by_creator() const { return creatorKey(creator, tournament_id); }
+         uint128_t by_start_time() const { return startKey(timestamp_start, tournament_id); }
+         uint128_t by_creator_game_end() const { return creatorGameEndKey(creator, game, timestamp_end); }
+         uint128_t by_game_start() const { return gameStartKey(game, timestamp_start, tournament_id); }
+      };
+
+      typedef multi_index<name("tournaments2"), tournaments_s,
+         indexed_by < name("bycreator"), const_mem_fun < tournaments_s, uint128_t, &tournaments_s::by_creator>>,
+         indexed_by < name("bystarttime"), const_mem_fun < tournaments_s, uint128_t, &tournaments_s::by_start_time>>,
+         indexed_by < name("bycrgameend"), const_mem_fun < tournaments_s, uint128_t, &tournaments_s::by_creator_game_end>>,
+         indexed_by < name("bygamestart"), const_mem_fun < tournaments_s, uint128_t, &tournaments_s::by_game_start>>> 
+      tournaments_t;
+    
+      tournaments_t tournaments = tournaments_t(get_self(), get_self().value);
+
+#ifdef CLASHDOME_GAME_SCOPES
+      // game of each tournament, so tournaments scoped by game can be found by id
+      TABLE trngames_s {
+
+         uint64_t tournament_id;
+         uint8_t game;
+
+         uint64_t primary_key() const { return tournament_id; }
+      };
+
+      typedef multi_index<name("trngames"), trngames_s> trngames_t;
+
+      trngames_t trngames = trngames_t(get_self(), get_self().value);
+#endif
+
+      // tournaments, legacy layout only read by migratetrn
+      TABLE legacy_tournaments_s {
+        
+         uint64_t tournament_id;
+         eosio::name creator;
          string name;
          uint64_t game;
          uint64_t timestamp_start; 
@@ -149,26 +450,27 @@ CONTRACT clashdometrn : public contract {
          uint64_t primary_key() const { return tournament_id; }
          uint64_t by_creator() const { return creator.value; }
          uint64_t by_start_time() const { return timestamp_start; }
+         uint128_t by_creator_game_end() const { return creatorGameEndKey(creator, game, timestamp_end); }
       };
 
-      typedef multi_index<name("tournaments"), tournaments_s,
-         indexed_by < name("bycreator"), const_mem_fun < tournaments_s, uint64_t, &tournaments_s::by_creator>>,
-         indexed_by < name("bystarttime"), const_mem_fun < tournaments_s, uint64_t, &tournaments_s::by_start_time>>> 
-      tournaments_t;
-    
-      tournaments_t tournaments = tournaments_t(get_self(), get_self().value);
+      typedef multi_index<name("tournaments"), legacy_tournaments_s,
+         indexed_by < name("bycreator"), const_mem_fun < legacy_tournaments_s, uint64_t, &legacy_tournaments_s::by_creator>>,
+         indexed_by < name("bystarttime"), const_mem_fun < legacy_tournaments_s, uint64_t, &legacy_tournaments_s::by_start_time>>,
+         indexed_by < name("bycrgameend"), const_mem_fun < legacy_tournaments_s, uint128_t, &legacy_tournaments_s::by_creator_game_end>>> 
+      legacy_tournaments_t;
 
       // creators
       TABLE creators_s {
         
          name creator;
          string img;
-         vector <extended_symbol> supported_tokens_fee;
+         vector <extended_symbol> supported_tokens_fee; // legacy, moved to the tokens table
          bool stake_available;
-         vector <extended_symbol> supported_tokens_stake;
+         vector <extended_symbol> supported_tokens_stake; // legacy, moved to the tokens table
          bool nft_available;
          bool pot_available;
-         vector <asset> funds;
+         vector <asset> funds; // legacy, moved to the balances table
+         eosio::binary_extension <uint64_t> img_ref; // interned img, img is empty then
 
          uint64_t primary_key() const { return creator.value; }
       };
@@ -177,40 +479,557 @@ CONTRACT clashdometrn : public contract {
     
       creators_t creators = creators_t(get_self(), get_self().value);
 
-      // checks
-      TABLE checks_s {
-        
+      // strings repeated across rows, see internString
+      TABLE strings_s {
+
+         uint64_t id; // hash of the value, the next free id on collisions
+         string value;
+         uint32_t refs; // rows holding the id
+
+         uint64_t primary_key() const { return id; }
+      };
+
+      typedef multi_index<name("strings"), strings_s> strings_t;
+
+      strings_t strings = strings_t(get_self(), get_self().value);
+
+      // creators being purged, see purgecreator
+      TABLE purges_s {
+
          name creator;
-         name account;
+         uint8_t stage; // PurgeStage
+         uint64_t cursor; // last tournament kept by the tournaments stage, 0 for none
+
+         uint64_t primary_key() const { return creator.value; }
+      };
+
+      typedef multi_index<name("purges"), purges_s> purges_t;
+
+      purges_t purges = purges_t(get_self(), get_self().value);
+
+      // position of the bounded scans over started tournaments, see scanStarted. No row means a new pass
+      TABLE scans_s {
+
+         name scan; // action running the scan
+         uint64_t scope; // tournament scope the scan stopped in
+         uint32_t timestamp_start; // first row left, resumed with lower_bound when it is erased meanwhile
          uint64_t tournament_id;
+
+         uint64_t primary_key() const { return scan.value; }
+      };
+
+      typedef multi_index<name("scans"), scans_s> scans_t;
+
+      scans_t scans = scans_t(get_self(), get_self().value);
+
+      // balances, scoped by creator
+      TABLE balances_s {
+
+         asset funds;
+         eosio::binary_extension <name> contract; // contract of the funds tokens, recorded by the first credit that knows it
+
+         uint64_t primary_key() const { return funds.symbol.code().raw(); }
+      };
+
+      typedef multi_index<name("balances"), balances_s> balances_t;
+
+      // deposits waiting to be sent to clashdomepay, scoped by token contract. deposited is always pending + swept, 
+      // clashdomepay holds swept - paid for the contract and pays every prize and refund, see payOut
+      TABLE sweeps_s {
+
+         extended_symbol token;
+         asset pending;
+         asset swept;
+         asset deposited;
+         asset threshold;
+         asset paid; // paid out by clashdomepay
+
+         uint64_t primary_key() const { return token.get_symbol().raw(); }
+      };
+
+      typedef multi_index<name("sweeps"), sweeps_s> sweeps_t;
+
+      // tokens, scoped by the contract for global tokens and by the creator for its own tokens
+      TABLE tokens_s {
+
+         extended_symbol token;
+         uint8_t type; // TOKEN_FEE | TOKEN_STAKE
+
+         bool matches(const extended_symbol& other, uint8_t other_type) const {
+            return (type & other_type) != 0 && (other.get_contract() == name() || other.get_contract() == token.get_contract());
+         }
+
+         uint64_t primary_key() const { return token.get_symbol().raw(); }
+      };
+
+      typedef multi_index<name("tokens"), tokens_s> tokens_t;
+
+      // player entries, scoped by tournament
+      TABLE entries_s {
+
+         name account;
+         uint32_t round_start; // timestamp_start of the round joined, older rounds are stale
+         uint32_t timestamp;
+         asset fee;
+
+         uint64_t primary_key() const { return account.value; }
+      };
+
+      typedef multi_index<name("entries"), entries_s> entries_t;
+
+      // nfts locked by players to meet the nft requirement, scoped by tournament
+      TABLE nftlocks_s {
+
+         uint64_t asset_id;
+         name account;
+         uint32_t round_start; // timestamp_start of the round joined
+
+         uint64_t primary_key() const { return asset_id; }
+         uint128_t by_account_round() const { return ((uint128_t) account.value << 64) | round_start; }
+      };
+
+      typedef multi_index<name("nftlocks"), nftlocks_s,
+         indexed_by < name("byaccround"), const_mem_fun < nftlocks_s, uint128_t, &nftlocks_s::by_account_round>>>
+      nftlocks_t;
+
+      // atomicassets assets, scoped by owner, only the leading fields of the row are read
+      struct atomic_assets_s {
+
+         uint64_t asset_id;
+         name collection_name;
+         name schema_name;
+         int32_t template_id;
+
+         uint64_t primary_key() const { return asset_id; }
+      };
+
+      typedef multi_index<name("assets"), atomic_assets_s> atomic_assets_t;
+
+      // best score of each player in the current round, scoped by tournament
+      TABLE scores_s {
+
+         name account;
+         uint32_t round_start; // timestamp_start of the round played, older rounds are stale
+         uint32_t timestamp;
+         uint64_t best;
+
+         uint64_t primary_key() const { return account.value; }
+      };
+
+      typedef multi_index<name("scores"), scores_s> scores_t;
+
+      // top LEADERBOARD_SIZE players of the current round, scoped by tournament
+      TABLE leaderboard_s {
+
+         name account;
+         uint32_t timestamp;
+         uint64_t score;
+
+         uint64_t primary_key() const { return account.value; }
+         uint128_t by_rank() const { return rankKey(score, timestamp); }
+      };
+
+      typedef multi_index<name("leaderboard"), leaderboard_s,
+         indexed_by < name("byrank"), const_mem_fun < leaderboard_s, uint128_t, &leaderboard_s::by_rank>>>
+      leaderboard_t;
+
+      // committed results of a round, scoped by tournament
+      TABLE results_s {
+
+         uint32_t round_start;
+         checksum256 root;
+         extended_asset total;
+         asset claimed;
+         name creator; // gets back what isn't claimed, see pruneresults
+         uint32_t expires; // end of the claim period
+
+         uint64_t primary_key() const { return round_start; }
+      };
+
+      typedef multi_index<name("results"), results_s> results_t;
+
+      // claimed results bitmap, scoped by tournament, bit i % 64 of word i / 64 is set once leaf i is claimed
+      TABLE claims_s {
+
+         uint64_t word; // round_start (32 bits) | leaf index / 64 (32 bits)
+         uint64_t bits;
+
+         uint64_t primary_key() const { return word; }
+      };
+
+      typedef multi_index<name("claims"), claims_s> claims_t;
+
+      // moderation records, scoped by tournament
+      TABLE modlog_s {
+        
+         uint64_t sequence;
+         name account;
          uint64_t timestamp;
          string type;
 
-         uint64_t primary_key() const { return creator.value; }
+         uint64_t primary_key() const { return sequence; }
+         uint128_t by_account() const { return ((uint128_t) account.value << 64) | sequence; }
       };
 
-      typedef multi_index<name("checks"), checks_s> checks_t;
-    
-      checks_t checks = checks_t(get_self(), get_self().value);
+      typedef multi_index<name("modlog"), modlog_s,
+         indexed_by < name("byaccount"), const_mem_fun < modlog_s, uint128_t, &modlog_s::by_account>>>
+      modlog_t;
+
+      // next moderation record sequence of each tournament, kept while the tournament or its records exist
+      TABLE modseqs_s {
+
+         uint64_t tournament_id;
+         uint64_t next;
+
+         uint64_t primary_key() const { return tournament_id; }
+      };
+
+      typedef multi_index<name("modseqs"), modseqs_s> modseqs_t;
+
+      modseqs_t modseqs = modseqs_t(get_self(), get_self().value);
 
       // config
       TABLE config_s {
          uint64_t tournament_counter = 1;
-         vector <extended_symbol> supported_tokens_fee = {};
-         vector <extended_symbol> supported_tokens_stake = {};
+         vector <extended_symbol> supported_tokens_fee = {}; // legacy, moved to the tokens table
+         vector <extended_symbol> supported_tokens_stake = {}; // legacy, moved to the tokens table
       };
 
       typedef singleton <name("config"), config_s> config_t;
       config_t config = config_t(get_self(), get_self().value);
       typedef multi_index <name("config"), config_s> config_t_for_abi;
 
+      // ROW CACHE
+      // rows read through these helpers are kept for the whole action, changed rows are written 
+      // back once when the contract object is destroyed at the end of the action
+
+      enum RowState : uint8_t {ROW_CLEAN, ROW_DIRTY, ROW_NEW, ROW_ERASED};
+
+      struct cached_creator {
+         creators_s row;
+         RowState state;
+      };
+
+      // balances are written back only when their amount differs from the loaded one
+      struct cached_balance {
+         balances_s row;
+         RowState state; // ROW_CLEAN or ROW_NEW
+         int64_t loaded; // amount when the row was loaded, 0 for new rows
+      };
+
+      std::optional <config_s> cached_config;
+      bool config_dirty = false;
+
+      std::map <uint64_t, cached_creator> cached_creators;
+
+      // keyed by (creator, symbol code), the tables are kept alive to reuse their loaded rows on flush
+      std::map <std::pair <uint64_t, uint64_t>, cached_balance> cached_balances;
+      std::map <uint64_t, balances_t> balances_tables;
+
+      // TOURNAMENT SCOPES
+      // tournaments live in the contract scope, builds with CLASHDOME_GAME_SCOPES give each game of the 
+      // registry its own scope and keep the trngames directory. The contract scope is still read there 
+      // for rows not moved yet by migratescope
+
+      // table for new tournaments of a game
+      tournaments_t& tournamentsOf(
+         uint64_t game
+      );
+
+      // table holding a tournament, the contract scope when its id isn't in the directory
+      tournaments_t& tournamentsFor(
+         uint64_t tournament_id
+      );
+
+      tournaments_t& tournamentsIn(
+         uint64_t scope
+      );
+
+      // scopes walked by the scans over every game, in order
+      vector <uint64_t> tournamentScopes();
+
+      void setTournamentGame(
+         uint64_t tournament_id,
+         uint8_t game
+      );
+
+      void eraseTournamentGame(
+         uint64_t tournament_id
+      );
+
+      bool hasTournaments(
+         name creator
+      );
+
+#ifdef CLASHDOME_GAME_SCOPES
+      std::map <uint64_t, tournaments_t> tournaments_tables;
+#endif
+
+      // INTERNED STRINGS
+      // tournament names and creator imgs longer than a handle are stored once in the strings table, 
+      // rows keep the handle and an empty inline string
+
+      // takes a reference to the value, 0 when it is short enough to stay inline
+      uint64_t internString(
+         const string& value
+      );
+
+      void releaseString(
+         uint64_t handle
+      );
+
+      string stringOf(
+         const string& value,
+         const eosio::binary_extension <uint64_t>& handle
+      );
+
+      // sets a string field and its handle, releasing the previous value
+      void setString(
+         string& value,
+         eosio::binary_extension <uint64_t>& handle,
+         const string& new_value
+      );
+
+      const config_s& getConfig();
+
+      config_s& editConfig();
+
+      cached_creator* loadCreator(
+         name creator
+      );
+
+      const creators_s* findCreator(
+         name creator
+      );
+
+      creators_s& editCreator(
+         name creator
+      );
+
+      void emplaceCreator(
+         const creators_s& creator
+      );
+
+      void eraseCreator(
+         name creator
+      );
+
+      // missing balances start with a zero amount and are only created once it changes
+      balances_s& editBalance(
+         name creator,
+         symbol sym
+      );
+
+      void flushCache();
+
+#ifdef CLASHDOME_INSTRUMENT
+      // INSTRUMENTATION
+
+      struct action_stats {
+         name action;
+         uint32_t inline_actions = 0;
+         vector <table_stats> tables;
+
+         table_stats& of(name table) {
+            for (table_stats& tbl : tables) {
+               if (tbl.table == table) {
+                  return tbl;
+               }
+            }
+            tables.push_back(table_stats{table, 0, 0, 0, 0, 0, 0});
+            return tables.back();
+         }
+
+         void write(name table, uint32_t table_stats::* counter, size_t bytes) {
+            table_stats& tbl = of(table);
+            (tbl.*counter)++;
+            tbl.bytes += bytes;
+         }
+      };
+
+      action_stats stats;
+#endif
+
       // AUXILIAR FUNCTIONS
 
+      // check whose message is only formatted when it fails, message returns the text to report
+      template <typename Message>
+      static void checkLazy(
+         bool condition,
+         Message&& message
+      ) {
+         if (!condition) {
+            check(false, message());
+         }
+      }
+
       void checkPendingTournament(
          name creator, 
          uint64_t timestamp_start, 
          uint64_t timestamp_end,
-         uint64_t game
+         uint64_t game,
+         uint64_t ignore_id
+      );
+
+      void checkNotPurged(
+         name creator
+      );
+
+      bool hasPendingTournament(
+         name creator, 
+         uint64_t timestamp_start, 
+         uint64_t timestamp_end,
+         uint64_t game,
+         uint64_t ignore_id
+      );
+
+      template <typename Table>
+      bool hasPendingTournamentIn(
+         Table& trn_table,
+         name creator,
+         uint64_t timestamp_start,
+         uint64_t timestamp_end,
+         uint64_t game,
+         uint64_t ignore_id
+      );
+
+      // visits up to max_rows started tournaments of every scope, oldest first, resuming where the 
+      // previous call of the scan stopped. visit(trn_table, trn_idx, trn_itr) returns the next row
+      template <typename Visit>
+      void scanStarted(
+         name scan,
+         uint64_t max_rows,
+         uint64_t current_timestamp,
+         Visit visit
+      );
+
+      // moves a finished recurring tournament to its next window. A paid out round debits a new prize pot, 
+      // an unpaid one carries its pot over. Returns false when the window overlaps another tournament or the creator lacks funds
+      bool rollTournament(
+         tournaments_t& trn_table,
+         const tournaments_s& trn,
+         uint64_t current_timestamp
+      );
+
+      // ~score (64 bits) | timestamp (64 bits), best score first and the earliest one on ties
+      static uint128_t rankKey(
+         uint64_t score,
+         uint64_t timestamp
+      ) {
+         return ((uint128_t) ~score << 64) | timestamp;
+      }
+
+      // creator (64 bits) | game (32 bits) | timestamp (32 bits)
+      static uint128_t creatorGameEndKey(
+         name creator,
+         uint64_t game,
+         uint64_t timestamp
+      ) {
+         return ((uint128_t) creator.value << 64) | ((game & 0xFFFFFFFF) << 32) | (timestamp & 0xFFFFFFFF);
+      }
+
+      // creator (64 bits) | tournament_id (64 bits)
+      static uint128_t creatorKey(
+         name creator,
+         uint64_t tournament_id
+      ) {
+         return ((uint128_t) creator.value << 64) | tournament_id;
+      }
+
+      // timestamp (32 bits) | tournament_id (64 bits)
+      static uint128_t startKey(
+         uint64_t timestamp,
+         uint64_t tournament_id
+      ) {
+         return ((uint128_t) (timestamp & 0xFFFFFFFF) << 64) | tournament_id;
+      }
+
+      // game (32 bits) | timestamp (32 bits) | tournament_id (64 bits)
+      static uint128_t gameStartKey(
+         uint64_t game,
+         uint64_t timestamp,
+         uint64_t tournament_id
+      ) {
+         return ((uint128_t) (game & 0xFFFFFFFF) << 96) | startKey(timestamp, tournament_id);
+      }
+
+      // fills a page walking an index from trn_itr while in_range holds, keeping the rows that match. 
+      // The next cursor is the position of the first row left out
+      template <typename Index, typename InRange, typename Matches, typename Position>
+      trn_page fillPage(
+         const Index& trn_idx,
+         typename Index::const_iterator trn_itr,
+         uint64_t limit,
+         uint64_t current_timestamp,
+         InRange in_range,
+         Matches matches,
+         Position position
+      );
+
+      // fills a page walking every tournament scope in turn from the scope of the cursor, 
+      // fill(trn_table, resume, limit) fills from the position resume, the start of its range when 0
+      template <typename Fill>
+      trn_page fillScopesPage(
+         uint128_t cursor,
+         uint64_t limit,
+         Fill fill
+      );
+
+      void createTournaments(
+         name creator,
+         const vector <tournament_spec>& specs
+      );
+
+      void checkTournament(
+         const creators_s& creator,
+         const tournament_spec& spec,
+         uint64_t current_timestamp
+      );
+
+      void setTournament(
+         tournaments_s& trn,
+         const tournament_spec& spec
+      );
+
+      void addModerationRecords(
+         name creator,
+         uint64_t tournament_id,
+         const vector <name>& accounts,
+         const string& type
+      );
+
+      void pruneModerationRecords(
+         modlog_t& modlog,
+         uint64_t current_timestamp,
+         uint64_t max_rows
+      );
+
+      static uint8_t toPotType(
+         const string& type_prize_pot
+      );
+
+      static std::optional <nft_requirement> toNftRequirement(
+         const string& requeriment_nft
+      );
+
+      // returns the message of the first malformed field, nullptr once requirement is filled
+      static const char* parseNftRequirement(
+         std::string_view requeriment_nft,
+         nft_requirement& requirement
+      );
+
+      static bool isName(
+         std::string_view value
+      );
+
+      static uint8_t phaseOf(
+         const tournaments_s& trn,
+         uint64_t current_timestamp
+      );
+
+      trn_summary toSummary(
+         const tournaments_s& trn,
+         uint64_t current_timestamp
       );
 
       void checkFeeAndStake(
@@ -219,6 +1038,199 @@ CONTRACT clashdometrn : public contract {
          asset requeriment_stake
       );
 
+      void accrueDeposit(
+         name contract,
+         const asset& quantity,
+         const string& memo
+      );
+
+      // creates the row of the token if it doesn't exist, sweeps has to be the scope of its contract
+      sweeps_t::const_iterator findSweep(
+         sweeps_t& sweeps,
+         const extended_symbol& token
+      );
+
+      // quantity is taken by value, callers sweeping everything pass swp.pending itself
+      void sweepPending(
+         sweeps_s& swp,
+         asset quantity,
+         const string& memo
+      );
+
+      // transfers quantity from clashdomepay, sweeping the pending deposits of the token first. 
+      // clashdomepay has to grant its active permission to the eosio.code permission of the contract
+      void payOut(
+         const extended_asset& quantity,
+         name to,
+         const string& memo
+      );
+
+      void addBalance(
+         name creator,
+         const asset& quantity,
+         name contract
+      );
+
+      // false when the funds of the symbol are held in tokens of another contract
+      bool tryAddBalance(
+         name creator,
+         const asset& quantity,
+         name contract
+      );
+
+      void subBalance(
+         name creator,
+         const asset& quantity
+      );
+
+      bool trySubBalance(
+         name creator,
+         const asset& quantity
+      );
+
+      // records the entry of a player paying the fee of a tournament with a "join:<tournament_id>" transfer
+      void joinTournament(
+         name account,
+         uint64_t tournament_id,
+         const extended_asset& payment
+      );
+
+      // locks the nfts sent with a "join:<tournament_id>" transfer, completing the entry of 
+      // tournaments without fee once the required count is locked
+      void lockNfts(
+         name account,
+         uint64_t tournament_id,
+         const vector <uint64_t>& asset_ids
+      );
+
+      // finds a tournament open to entries, rolling it forward first when it's a finished recurring one
+      tournaments_t::const_iterator findJoinable(
+         tournaments_t& trn_table,
+         uint64_t tournament_id,
+         uint64_t current_timestamp
+      );
+
+      void addEntry(
+         tournaments_t& trn_table,
+         tournaments_t::const_iterator trn_itr,
+         name account,
+         const asset& quantity,
+         uint64_t current_timestamp
+      );
+
+      // nfts locked by the account for the current round, counting at most up to limit
+      uint64_t lockedNfts(
+         const tournaments_s& trn,
+         name account,
+         uint64_t limit
+      );
+
+      // splits a "command[:argument]" memo without copying it, returns a MemoCommand
+      static uint8_t toMemoCommand(
+         std::string_view memo,
+         std::string_view& argument
+      );
+
+      // leaf of a results tree, sha256 of tournament_id (8) | round_start (4) | index (4) | account (8) | amount (8) | symbol (8), 
+      // little endian, and parents are sha256 of left | right where the index bits tell the side of each level
+      static checksum256 resultsLeaf(
+         uint64_t tournament_id,
+         uint32_t round_start,
+         uint32_t index,
+         name account,
+         const asset& amount
+      );
+
+      static checksum256 resultsParent(
+         const checksum256& left,
+         const checksum256& right
+      );
+
+      static uint64_t toNumber(
+         std::string_view value,
+         uint64_t max,
+         const char* message
+      );
+
+      static bool parseNumber(
+         std::string_view value,
+         uint64_t max,
+         uint64_t& number
+      );
+
+      static round_state roundOf(
+         const tournaments_s& trn
+      );
+
+      // a finished round with entries or scores can be rolled or pruned once it has been paid out. 
+      // Rounds without them are settled too but still hold the prize pot, see releasePot
+      static bool isSettled(
+         const tournaments_s& trn
+      );
+
+      // returns the prize pot of a round that wasn't paid out to the creator funds, before erasing its tournament
+      void releasePot(
+         const tournaments_s& trn
+      );
+
+      // places an improved best score in the leaderboard if it makes the top LEADERBOARD_SIZE
+      void rankScore(
+         leaderboard_t& leaderboard,
+         round_state& round,
+         name account,
+         uint64_t score,
+         uint64_t current_timestamp
+      );
+
+      // prize pot of the current round, including the entry fees collected so far
+      static asset currentPot(
+         const tournaments_s& trn
+      );
+
+      // contract of a fee token known by the creator, global tokens first
+      name tokenContract(
+         name creator,
+         const symbol& sym
+      );
+
+      // as tokenContract, an empty name when the symbol isn't a fee token
+      name findTokenContract(
+         name creator,
+         const symbol& sym
+      );
+
+      // contract the creator funds of the symbol are held in
+      name fundsContract(
+         name creator,
+         const symbol& sym
+      );
+
+      // contract the prize pot and the fees of the tournament are paid in
+      name potContract(
+         const tournaments_s& trn
+      );
+
+      // an empty contract in token matches the symbol from any contract
+      bool isTokenSupported(
+         name creator,
+         const extended_symbol& token,
+         uint8_t type
+      );
+
+      bool addToken(
+         name scope,
+         const extended_symbol& token,
+         uint8_t type
+      );
+
+      // adds a legacy token, adding one twice is fine but a symbol registered from another contract goes to skipped
+      void migrateToken(
+         name scope,
+         const extended_symbol& token,
+         uint8_t type,
+         vector <skipped_token>& skipped
+      );
+
       // VARIABLES
 
       // wax
@@ -229,9 +1241,25 @@ CONTRACT clashdometrn : public contract {
       const string ALIEN_WORLDS_CONTRACT = "alien.worlds";
       static constexpr symbol TLM_SYMBOL = symbol(symbol_code("TLM"), 4);
 
+      // token types
+      static constexpr uint8_t TOKEN_FEE = 1;
+      static constexpr uint8_t TOKEN_STAKE = 2;
+
+      // leaderboard rows kept per tournament
+      static constexpr uint32_t LEADERBOARD_SIZE = 100;
+
+      // moderation records are kept for 30 days (seconds)
+      const uint64_t MODLOG_RETENTION = 30 * 24 * 3600;
+
+      // committed results can be claimed for 30 days (seconds)
+      const uint64_t CLAIM_PERIOD = 30 * 24 * 3600;
+
+      // recurring tournaments repeat every whole number of days (seconds)
+      const uint64_t RECREATE_PERIOD = 24 * 3600;
+
       // timestamps (hours)
-      const uint64_t MAX_DURATION = 168; // 7 day * 24 hours
-      const uint64_t MIN_DURATION = 1; // 1 hour
+      static constexpr uint32_t MAX_DURATION = 168; // 7 day * 24 hours
+      static constexpr uint32_t MIN_DURATION = 1; // 1 hour
 
       // games
       enum GameType {CANDY_FIESTA = 1, TEMPLOK, RINGY_DINGY, ENDLESS_SIEGE_2, RUG_POOL, PAC_MAN};
@@ -239,4 +1267,65 @@ CONTRACT clashdometrn : public contract {
       // prize pots
       const string POT_MINIMUM = "MINIMUM";
       const string POT_BONUS = "BONUS";
+      enum PotType : uint8_t {NO_POT = 0, MINIMUM_POT, BONUS_POT};
+
+      // game rules, durations in hours and allowed pot types as a mask of 1 << PotType
+      struct game_rules {
+         uint8_t game;
+         uint32_t min_duration;
+         uint32_t max_duration;
+         uint8_t pot_types;
+         bool nft_allowed;
+      };
+
+      static constexpr uint8_t ANY_POT = (1 << NO_POT) | (1 << MINIMUM_POT) | (1 << BONUS_POT);
+
+      // game registry, game n is GAMES[n - 1]
+      static constexpr game_rules GAMES[] = {
+         {CANDY_FIESTA, MIN_DURATION, MAX_DURATION, ANY_POT, true},
+         {TEMPLOK, MIN_DURATION, MAX_DURATION, ANY_POT, true},
+         {RINGY_DINGY, MIN_DURATION, MAX_DURATION, ANY_POT, true},
+         {ENDLESS_SIEGE_2, MIN_DURATION, MAX_DURATION, ANY_POT, true},
+         {RUG_POOL, MIN_DURATION, MAX_DURATION, ANY_POT, true},
+         {PAC_MAN, MIN_DURATION, MAX_DURATION, ANY_POT, true}
+      };
+
+      static constexpr uint64_t GAME_COUNT = sizeof(GAMES) / sizeof(GAMES[0]);
+
+      static_assert([]() {
+         for (uint64_t i = 0; i < GAME_COUNT; i++) {
+            if (GAMES[i].game != i + 1 || GAMES[i].min_duration > GAMES[i].max_duration) {
+               return false;
+            }
+         }
+         return true;
+      }(), "GAMES has to list every game once, in id order, with valid durations.");
+
+      static constexpr const game_rules* findGame(
+         uint64_t game
+      ) {
+         return game >= 1 && game <= GAME_COUNT ? &GAMES[game - 1] : nullptr;
+      }
+
+      // purgecreator stages, run in order
+      enum PurgeStage : uint8_t {PURGE_TOURNAMENTS = 0, PURGE_BALANCES, PURGE_TOKENS};
+
+      // rounds, see isSettled
+      enum RoundStatus : uint8_t {ROUND_OPEN = 0, ROUND_PAYING, ROUND_PAID};
+
+      // transfer memos
+      enum MemoCommand : uint8_t {MEMO_UNKNOWN = 0, MEMO_ADD_TOKENS, MEMO_ADD_FUNDS, MEMO_JOIN};
+
+      // tournament phases, ANY_PHASE is only used as a query filter
+      enum TournamentPhase : uint8_t {ANY_PHASE = 0, UPCOMING, RUNNING, FINISHED};
+
+      // queries return at most MAX_PAGE_SIZE rows and visit at most MAX_QUERY_ROWS rows per call
+      static constexpr uint64_t MAX_PAGE_SIZE = 50;
+      static constexpr uint64_t MAX_QUERY_ROWS = 500;
+
+      // query cursors, scope number in tournamentScopes() (32 bits) | position in the index of that scope (96 bits)
+      static constexpr uint128_t CURSOR_POSITION = ((uint128_t) 1 << 96) - 1;
+
+      // tournament rows
+      static constexpr uint8_t TOURNAMENT_VERSION = 1;
 };
\ No newline at end of file
@@ -1,5 +1,25 @@
 #include <clashdometrn.hpp>
 
+/**
+*  Writes back the rows changed through the row cache during the action and, in instrumented 
+*  builds, logs the work done by the action
+*/
+clashdometrn::~clashdometrn()
+{
+   flushCache();
+
+#ifdef CLASHDOME_INSTRUMENT
+   if (stats.action != name()) {
+      action(
+         permission_level{get_self(), name("active")},
+         get_self(),
+         name("logstats"),
+         std::make_tuple(stats.action, stats.tables, stats.inline_actions)
+      ).send();
+   }
+#endif
+}
+
 /**
 *  Initializes the config table. Only needs to be called once when first deploying the contract
 *  @required_auth The contract itself
@@ -7,6 +27,8 @@
 ACTION clashdometrn::initconfig() 
 {
 
+   INSTRUMENT_ACTION("initconfig");
+
    require_auth(get_self());
 
    config.get_or_create(get_self(), config_s{});
@@ -19,9 +41,14 @@ ACTION clashdometrn::initconfig()
 ACTION clashdometrn::removeconfig() 
 {
 
+   INSTRUMENT_ACTION("removeconfig");
+
    require_auth(get_self());
 
    config.remove();
+
+   cached_config.reset();
+   config_dirty = false;
 }
 
 /**
@@ -33,23 +60,181 @@ ACTION clashdometrn::addconftoken(
    symbol token_symbol,
    string type) 
 {
+   INSTRUMENT_ACTION("addconftoken");
+
+   require_auth(get_self());
+
+   uint8_t token_type = type == "fee" ? TOKEN_FEE : TOKEN_STAKE;
+
+   check(addToken(get_self(), extended_symbol(token_symbol, token_contract), token_type), "A token with this symbol is already supported");
+}
+
+/**
+*  Moves the supported tokens stored in the config and creators rows to the tokens table.
+*  Modifies at most max_rows creators per call. Tokens whose symbol the scope already supports from 
+*  another contract are left out and logged in a single logtknskip action
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::migratetkns(
+   uint64_t max_rows
+)
+{
+   INSTRUMENT_ACTION("migratetkns");
+
    require_auth(get_self());
 
-   config_s current_config = config.get();
+   const config_s& current_config = getConfig();
+   vector <skipped_token> skipped;
+
+   if (!current_config.supported_tokens_fee.empty() || !current_config.supported_tokens_stake.empty()) {
 
-   if (type == "fee") {
-      for (extended_symbol token : current_config.supported_tokens_fee) {
-         check(token.get_symbol() != token_symbol, "A token with this symbol is already supported");
+      for (const extended_symbol& token : current_config.supported_tokens_fee) {
+         migrateToken(get_self(), token, TOKEN_FEE, skipped);
       }
-      current_config.supported_tokens_fee.push_back(extended_symbol(token_symbol, token_contract));
-   } else {
-      for (extended_symbol token : current_config.supported_tokens_stake) {
-         check(token.get_symbol() != token_symbol, "A token with this symbol is already supported");
+
+      for (const extended_symbol& token : current_config.supported_tokens_stake) {
+         migrateToken(get_self(), token, TOKEN_STAKE, skipped);
       }
-      current_config.supported_tokens_stake.push_back(extended_symbol(token_symbol, token_contract));
+
+      config_s& edited_config = editConfig();
+      edited_config.supported_tokens_fee.clear();
+      edited_config.supported_tokens_stake.clear();
+   }
+
+   uint64_t migrated = 0;
+
+   for (auto cr_itr = creators.begin(); cr_itr != creators.end() && migrated < max_rows; cr_itr++) {
+
+      INSTRUMENT_OP("creators", steps);
+
+      if (cr_itr->supported_tokens_fee.empty() && cr_itr->supported_tokens_stake.empty()) {
+         continue;
+      }
+
+      for (const extended_symbol& token : cr_itr->supported_tokens_fee) {
+         migrateToken(cr_itr->creator, token, TOKEN_FEE, skipped);
+      }
+
+      for (const extended_symbol& token : cr_itr->supported_tokens_stake) {
+         migrateToken(cr_itr->creator, token, TOKEN_STAKE, skipped);
+      }
+
+      creators_s& cr = editCreator(cr_itr->creator);
+      cr.supported_tokens_fee.clear();
+      cr.supported_tokens_stake.clear();
+
+      migrated++;
+   }
+
+   if (!skipped.empty()) {
+      action(
+         permission_level{get_self(), name("active")},
+         get_self(),
+         name("logtknskip"),
+         std::make_tuple(skipped)
+      ).send();
+      INSTRUMENT_INLINE();
+   }
+}
+
+/**
+*  Moves the funds stored in the creators rows to the balances table.
+*  Modifies at most max_rows creators per call
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::migratefnds(
+   uint64_t max_rows
+)
+{
+   INSTRUMENT_ACTION("migratefnds");
+
+   require_auth(get_self());
+
+   uint64_t migrated = 0;
+
+   for (auto cr_itr = creators.begin(); cr_itr != creators.end() && migrated < max_rows; cr_itr++) {
+
+      INSTRUMENT_OP("creators", steps);
+
+      if (cr_itr->funds.empty()) {
+         continue;
+      }
+
+      for (const asset& funds : cr_itr->funds) {
+         addBalance(cr_itr->creator, funds, name());
+      }
+
+      editCreator(cr_itr->creator).funds.clear();
+
+      migrated++;
+   }
+}
+
+/**
+*  Moves up to max_rows tournaments from the legacy table to the compact one, keeping their ids.
+*  NFT requirements that can't be parsed are dropped and logged in a single lognftdrop action
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::migratetrn(
+   uint64_t max_rows
+)
+{
+   INSTRUMENT_ACTION("migratetrn");
+
+   require_auth(get_self());
+
+   legacy_tournaments_t legacy_tournaments = legacy_tournaments_t(get_self(), get_self().value);
+
+   auto trn_itr = legacy_tournaments.begin();
+   vector <dropped_nft> dropped;
+
+   for (uint64_t migrated = 0; migrated < max_rows && trn_itr != legacy_tournaments.end(); migrated++) {
+
+      INSTRUMENT_OP("tournaments", steps);
+
+      // the legacy actions stored the requirement unchecked, a malformed one would block every later row
+      string requeriment_nft = trn_itr->requeriment_nft;
+      nft_requirement requirement;
+
+      if (!requeriment_nft.empty() && parseNftRequirement(requeriment_nft, requirement) != nullptr) {
+         dropped.push_back(dropped_nft{trn_itr->tournament_id, requeriment_nft});
+         requeriment_nft.clear();
+      }
+
+      auto new_itr = tournamentsOf(trn_itr->game).emplace(CONTRACTN, [&](auto& trn) {
+         trn.tournament_id = trn_itr->tournament_id;
+         trn.creator = trn_itr->creator;
+         setTournament(trn, tournament_spec{
+            trn_itr->name,
+            trn_itr->game,
+            trn_itr->timestamp_start,
+            trn_itr->timestamp_end,
+            trn_itr->requeriment_fee,
+            trn_itr->requeriment_stake,
+            requeriment_nft,
+            trn_itr->prize_pot,
+            trn_itr->type_prize_pot,
+            trn_itr->recreate
+         });
+      });
+
+      INSTRUMENT_WRITE("tournaments2", emplaces, *new_itr);
+
+      setTournamentGame(new_itr->tournament_id, new_itr->game);
+
+      trn_itr = legacy_tournaments.erase(trn_itr);
+      INSTRUMENT_OP("tournaments", erases);
+   }
+
+   if (!dropped.empty()) {
+      action(
+         permission_level{get_self(), name("active")},
+         get_self(),
+         name("lognftdrop"),
+         std::make_tuple(dropped)
+      ).send();
+      INSTRUMENT_INLINE();
    }
-   
-   config.set(current_config, get_self());
 }
 
 /**
@@ -70,75 +255,79 @@ ACTION clashdometrn::createtrn(
    bool recreate
 ) {
    
+   INSTRUMENT_ACTION("createtrn");
+
    require_auth(creator);
-   
-   // check timestamps
-   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
 
-   check(game <= 5, "Invalid game ID.");
+   createTournaments(creator, {tournament_spec{
+      name,
+      game,
+      timestamp_start,
+      timestamp_end,
+      requeriment_fee,
+      requeriment_stake,
+      requeriment_nft,
+      prize_pot,
+      type_prize_pot,
+      recreate
+   }});
+}
+
+#ifdef CLASHDOME_GAME_SCOPES
+/**
+*  Moves up to max_rows tournaments from the contract scope to the scope of their game, keeping 
+*  their ids. Tournaments of games outside the registry stay in the contract scope
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::migratescope(
+   uint64_t max_rows
+)
+{
+   INSTRUMENT_ACTION("migratescope");
 
-   check(timestamp_start >= current_timestamp, "The start time must be later than the current time.");
-   check(timestamp_start < timestamp_end, "The end time must be later than the start time.");
+   require_auth(get_self());
 
-   float duration = ((float)timestamp_end - (float)timestamp_start) / 3600.0;
+   auto trn_itr = tournaments.begin();
+   INSTRUMENT_OP("tournaments2", finds);
 
-   check(duration >= (float) MIN_DURATION && duration <= (float) MAX_DURATION, "Duration must be between " + to_string(MIN_DURATION) + " and " + to_string(MAX_DURATION) + " hours.");
+   for (uint64_t visited = 0; visited < max_rows && trn_itr != tournaments.end(); visited++) {
 
-   // check tournaments in progress
-   checkPendingTournament(creator, timestamp_start, timestamp_end, game);
+      INSTRUMENT_OP("tournaments2", steps);
 
-   // check fee and stake symbols
-   checkFeeAndStake(creator, requeriment_fee, requeriment_stake);
+      tournaments_t& game_table = tournamentsOf(trn_itr->game);
 
-   // check prizepot
-   check(requeriment_fee.amount == 0 || requeriment_fee.symbol == prize_pot.symbol, "Entry fee and prize pot symbols are different");
-   check(requeriment_fee.amount == 0 || type_prize_pot == POT_MINIMUM || type_prize_pot == POT_BONUS, "Invalid prize pot type.");
+      if (&game_table == &tournaments) {
+         trn_itr++;
+         continue;
+      }
 
-   auto cr_itr = creators.find(creator.value);
+      auto new_itr = game_table.emplace(CONTRACTN, [&](auto& trn) {
+         trn = *trn_itr;
+      });
+      INSTRUMENT_WRITE("tournaments2", emplaces, *new_itr);
 
-   // TODO: remove this after add permissions to create tournament with nft
-   check(cr_itr != creators.end(), "Invalid creator username");
+      setTournamentGame(new_itr->tournament_id, new_itr->game);
 
-   // check requeriment stake, nfts y pot
-   if (cr_itr == creators.end()) {
-      check(requeriment_stake.amount == 0, "Requeriment stake is not allowed.");
-      check(prize_pot.amount == 0, "Prize pot is not allowed.");
-      check(requeriment_nft == "", "Requeriment NFT is not allowed.");
-   } else {
-      check(cr_itr->stake_available || requeriment_stake.amount == 0, "Requeriment stake is not allowed.");
-      check(cr_itr->pot_available || prize_pot.amount == 0, "Prize pot is not allowed.");
-      check(cr_itr->nft_available || requeriment_nft == "", "Requeriment NFT is not allowed.");
+      trn_itr = tournaments.erase(trn_itr);
+      INSTRUMENT_OP("tournaments2", erases);
    }
+}
+#endif
 
-   // check creator funds
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == prize_pot.symbol; 
-      });
+/**
+*  Creates several tournaments at once, reserving consecutive ids
+*  @required_auth The tournament creator
+*/
+ACTION clashdometrn::createtrns(
+   name creator,
+   vector <tournament_spec> specs
+) {
+   
+   INSTRUMENT_ACTION("createtrns");
 
-      check(fund_itr != cr.funds.end() && fund_itr->amount >= prize_pot.amount, "Insufficient funds.");
-      *fund_itr -= prize_pot;
-   });
+   require_auth(creator);
 
-   config_s current_config = config.get();
-
-   uint64_t tournament_id = current_config.tournament_counter++;
-   config.set(current_config, get_self());
-
-   tournaments.emplace(CONTRACTN, [&](auto& trn) {
-      trn.tournament_id = tournament_id;
-      trn.creator = creator;
-      trn.name = name;
-      trn.game = game;
-      trn.timestamp_start = timestamp_start;
-      trn.timestamp_end = timestamp_end;
-      trn.requeriment_fee = requeriment_fee;
-      trn.requeriment_stake = requeriment_stake;
-      trn.requeriment_nft = requeriment_nft;
-      trn.prize_pot = prize_pot;
-      trn.type_prize_pot = type_prize_pot;
-      trn.recreate = recreate;
-   });
+   createTournaments(creator, specs);
 }
 
 /**
@@ -160,90 +349,74 @@ ACTION clashdometrn::edittrn(
    bool recreate
 ) {
    
+   INSTRUMENT_ACTION("edittrn");
+
    require_auth(creator);
 
-   check(game <= 5, "Invalid game ID.");
+   tournaments_t& trn_table = tournamentsFor(id);
 
-   auto trn_itr = tournaments.require_find(id, "No tournament with this id exists");
+   auto trn_itr = trn_table.require_find(id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
    check(trn_itr->creator == creator, "The specified account isn't the creator of the tournament.");
    
-   // check timestamps
    uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
 
    check(current_timestamp < trn_itr->timestamp_start, "You cannot cancel an initialized tournament.");
 
-   check(timestamp_start >= current_timestamp, "The start time must be later than the current time.");
-   check(timestamp_start < timestamp_end, "The end time must be later than the start time.");
+   check(roundOf(*trn_itr).entries == 0, "You cannot edit a tournament with entries.");
 
-   float duration = ((float)timestamp_end - (float)timestamp_start) / 3600.0;
+   const creators_s* cr = findCreator(creator);
 
-   check(duration >= (float) MIN_DURATION && duration <= (float) MAX_DURATION, "Duration must be between " + to_string(MIN_DURATION) + " and " + to_string(MAX_DURATION) + " hours.");
+   check(cr != nullptr, "Invalid creator username");
 
-   // check tournaments in progress
-   checkPendingTournament(creator, timestamp_start, timestamp_end, game);
+   checkNotPurged(creator);
 
-   // check fee and stake symbols
-   checkFeeAndStake(creator, requeriment_fee, requeriment_stake);
+   tournament_spec spec = {
+      name,
+      game,
+      timestamp_start,
+      timestamp_end,
+      requeriment_fee,
+      requeriment_stake,
+      requeriment_nft,
+      prize_pot,
+      type_prize_pot,
+      recreate
+   };
 
-   // check prizepot
-   check(requeriment_fee.amount == 0 || requeriment_fee.symbol == prize_pot.symbol, "Entry fee and prize pot symbols are different");
-   check(requeriment_fee.amount == 0 || type_prize_pot == POT_MINIMUM || type_prize_pot == POT_BONUS, "Invalid prize pot type.");
+   checkTournament(*cr, spec, current_timestamp);
 
-   auto cr_itr = creators.find(creator.value);
+   // check tournaments in progress
+   checkPendingTournament(creator, timestamp_start, timestamp_end, game, id);
 
-   // check requeriment stake, nfts y pot
-   if (cr_itr == creators.end()) {
-      check(requeriment_stake.amount == 0, "Requeriment stake is not allowed.");
-      check(prize_pot.amount == 0, "Prize pot is not allowed.");
-      check(requeriment_nft == "", "Requeriment NFT is not allowed.");
-   } else {
-      check(cr_itr->stake_available || requeriment_stake.amount == 0, "Requeriment stake is not allowed.");
-      check(cr_itr->pot_available || prize_pot.amount == 0, "Prize pot is not allowed.");
-      check(cr_itr->nft_available || requeriment_nft == "", "Requeriment NFT is not allowed.");
-   }
+   // add creator funds and check them against the new prize pot, both go to the same cached 
+   // balance when the symbol doesn't change so only the net difference is written
+   addBalance(creator, trn_itr->prize_pot, potContract(*trn_itr));
+   subBalance(creator, prize_pot);
 
-   // add creator funds
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == trn_itr->prize_pot.symbol; 
-      });
+   tournaments_t& game_table = tournamentsOf(game);
 
-      check(fund_itr != cr.funds.end() && fund_itr->amount >= trn_itr->prize_pot.amount, "Insufficient funds.");
-      *fund_itr += trn_itr->prize_pot;
-   });
-   
-   // check creator funds
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == prize_pot.symbol; 
+   if (&game_table == &trn_table) {
+      trn_table.modify(trn_itr, CONTRACTN, [&](auto& trn) {
+         setTournament(trn, spec);
       });
+      INSTRUMENT_WRITE("tournaments2", modifies, *trn_itr);
+      return;
+   }
 
-      check(fund_itr != cr.funds.end() && fund_itr->amount >= prize_pot.amount, "Insufficient funds.");
-      *fund_itr -= prize_pot;
-   });
+   // a new game moves the tournament to the scope of that game
+   tournaments_s moved = *trn_itr;
+   setTournament(moved, spec);
 
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == prize_pot.symbol; 
-      });
+   trn_table.erase(trn_itr);
+   INSTRUMENT_OP("tournaments2", erases);
 
-      check(fund_itr != cr.funds.end() && fund_itr->amount >= prize_pot.amount, "Insufficient funds.");
-      *fund_itr -= prize_pot;
+   auto new_itr = game_table.emplace(CONTRACTN, [&](auto& trn) {
+      trn = moved;
    });
+   INSTRUMENT_WRITE("tournaments2", emplaces, *new_itr);
 
-   tournaments.modify(trn_itr, CONTRACTN, [&](auto& trn) {
-      trn.creator = creator;
-      trn.name = name;
-      trn.game = game;
-      trn.timestamp_start = timestamp_start;
-      trn.timestamp_end = timestamp_end;
-      trn.requeriment_fee = requeriment_fee;
-      trn.requeriment_stake = requeriment_stake;
-      trn.requeriment_nft = requeriment_nft;
-      trn.prize_pot = prize_pot;
-      trn.type_prize_pot = type_prize_pot;
-      trn.recreate = recreate;
-   });
+   setTournamentGame(id, moved.game);
 }
 
 /**
@@ -256,27 +429,31 @@ ACTION clashdometrn::canceltrn(
 )
 {
 
+   INSTRUMENT_ACTION("canceltrn");
+
    require_auth(creator);
 
-   auto trn_itr = tournaments.require_find(tournament_id, "No tournament with this id exists");
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
    check(trn_itr->creator == creator, "The specified account isn't the creator of the tournament.");
 
    uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
 
    check(current_timestamp < trn_itr->timestamp_start, "You cannot cancel an initialized tournament.");
 
-   auto cr_itr = creators.find(creator.value);
+   check(roundOf(*trn_itr).entries == 0, "You cannot cancel a tournament with entries.");
 
    // add creator funds
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == trn_itr->prize_pot.symbol; 
-      });
-      
-      *fund_itr += trn_itr->prize_pot;
-   });
+   addBalance(creator, trn_itr->prize_pot, potContract(*trn_itr));
+
+   releaseString(trn_itr->name_ref.value_or(0));
+
+   trn_table.erase(trn_itr);
+   INSTRUMENT_OP("tournaments2", erases);
 
-   tournaments.erase(trn_itr);
+   eraseTournamentGame(tournament_id);
 }
 
 /**
@@ -289,329 +466,2719 @@ ACTION clashdometrn::fcanceltrn(
 )
 {
 
+   INSTRUMENT_ACTION("fcanceltrn");
+
    require_auth(get_self());
 
-   auto trn_itr = tournaments.require_find(tournament_id, "No tournament with this id exists");
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
    check(trn_itr->creator == creator, "The specified account isn't the creator of the tournament.");
 
-   tournaments.erase(trn_itr);
+   // paid entries are only settled by payout, erasing the row would strand their fees
+   check(roundOf(*trn_itr).entries == 0, "You cannot cancel a tournament with entries.");
+
+   releasePot(*trn_itr);
+   releaseString(trn_itr->name_ref.value_or(0));
+
+   trn_table.erase(trn_itr);
+   INSTRUMENT_OP("tournaments2", erases);
+
+   eraseTournamentGame(tournament_id);
 }
 
 /**
-*  Adds a token that can then be used in tournaments
-*  @required_auth The tournament creator
+*  Erases the finished tournaments among the next max_rows started ones, continuing where the previous 
+*  call stopped, and logs them in a single logprunetrn action. Recurring tournaments are rolled forward instead when possible
+*  @required_auth The contract itself
 */
-ACTION clashdometrn::rmusertrn(
-   name creator,
-   name account,
-   uint64_t tournament_id,
-   string type
+ACTION clashdometrn::prunetrn(
+   uint64_t max_rows
 )
 {
 
-   require_auth(creator);
+   INSTRUMENT_ACTION("prunetrn");
+
+   require_auth(get_self());
 
-   auto check_itr = checks.find(creator.value);
+   check(max_rows > 0, "max_rows has to be greater than 0.");
 
    uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
-   
-   if (check_itr == checks.end()) {
-      checks.emplace(CONTRACTN, [&](auto& check) {
-         check.creator = creator;
-         check.account = account;
-         check.tournament_id = tournament_id;
-         check.timestamp = current_timestamp;
-         check.type = type;
-      });
-   } else {
-      checks.modify(check_itr, CONTRACTN, [&](auto& check) {
-         check.account = account;
-         check.tournament_id = tournament_id;
-         check.timestamp = current_timestamp;
-         check.type = type;
+
+   vector <archived_tournament> archived;
+
+   scanStarted(name("prunetrn"), max_rows, current_timestamp, [&](tournaments_t& trn_table, auto& trn_idx, auto trn_itr) {
+
+      if (trn_itr->timestamp_end >= current_timestamp || !isSettled(*trn_itr)) {
+         return ++trn_itr;
+      }
+
+      // the rolled row moves ahead in the index, so step over it first
+      if (trn_itr->recreate) {
+         auto trn_next = trn_itr;
+         trn_next++;
+
+         if (rollTournament(trn_table, *trn_itr, current_timestamp)) {
+            return trn_next;
+         }
+      }
+
+      archived.push_back(archived_tournament{
+         trn_itr->tournament_id,
+         trn_itr->creator,
+         trn_itr->game,
+         trn_itr->timestamp_start,
+         trn_itr->timestamp_end,
+         trn_itr->prize_pot
       });
+
+      releasePot(*trn_itr);
+      eraseTournamentGame(trn_itr->tournament_id);
+      releaseString(trn_itr->name_ref.value_or(0));
+
+      trn_itr = trn_idx.erase(trn_itr);
+      INSTRUMENT_OP("tournaments2", erases);
+
+      return trn_itr;
+   });
+
+   if (!archived.empty()) {
+      action(
+         permission_level{get_self(), name("active")},
+         get_self(),
+         name("logprunetrn"),
+         std::make_tuple(archived)
+      ).send();
+      INSTRUMENT_INLINE();
    }
 }
 
 /**
-*  Adds a special creator
-*  @required_auth self
+*  Rolls forward the finished recurring tournaments among the next max_rows started ones, continuing where 
+*  the previous call stopped. Series that can't be rolled stop recurring and are left for prunetrn
+*  @required_auth The contract itself
 */
-ACTION clashdometrn::addcreator(
-   name creator,
-   string img,
-   vector <extended_symbol> supported_tokens_fee,
-   bool stake_available,
-   vector <extended_symbol> supported_tokens_stake,
-   bool nft_available,
-   bool pot_available
+ACTION clashdometrn::rollover(
+   uint64_t max_rows
 )
 {
 
+   INSTRUMENT_ACTION("rollover");
+
    require_auth(get_self());
 
-   check(creators.find(creator.value) == creators.end(), "Creator " + creator.to_string() + " already exists.");
+   check(max_rows > 0, "max_rows has to be greater than 0.");
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   scanStarted(name("rollover"), max_rows, current_timestamp, [&](tournaments_t& trn_table, auto& trn_idx, auto trn_itr) {
+
+      // the rolled row moves ahead in the index, so step over it first
+      auto trn_next = trn_itr;
+      trn_next++;
+
+      if (trn_itr->recreate && trn_itr->timestamp_end < current_timestamp && isSettled(*trn_itr) && !rollTournament(trn_table, *trn_itr, current_timestamp)) {
+         trn_idx.modify(trn_itr, CONTRACTN, [&](auto& trn) {
+            trn.recreate = false;
+         });
+         INSTRUMENT_WRITE("tournaments2", modifies, *trn_itr);
+      }
 
-   creators.emplace(CONTRACTN, [&](auto& crt) {
-      crt.creator = creator;
-      crt.img = img;
-      crt.supported_tokens_fee = supported_tokens_fee;
-      crt.stake_available = stake_available;
-      crt.supported_tokens_stake = supported_tokens_stake;
-      crt.nft_available = nft_available;
-      crt.pot_available = pot_available;
+      return trn_next;
    });
 }
 
 /**
-*  Edit a creator img
-*  @required_auth self
+*  Records a batch of scores of a running tournament, keeping the best score of each player 
+*  and the top LEADERBOARD_SIZE players
+*  @required_auth The oracle permission of the contract
 */
-ACTION clashdometrn::editcrimg(
-         name creator,
-         string img
-      )
+ACTION clashdometrn::submitscores(
+   uint64_t tournament_id,
+   vector <std::pair <name, uint64_t>> scores
+)
 {
-   require_auth(creator);
 
-   auto cr_itr = creators.find(creator.value);
+   INSTRUMENT_ACTION("submitscores");
 
-   check(cr_itr != creators.end(), "Creator " + creator.to_string() + " doesn't exists.");
+   require_auth(permission_level{get_self(), name("oracle")});
 
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      cr.img = img;
-   });
+   check(!scores.empty(), "No scores to submit.");
+
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
 
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   check(trn_itr->timestamp_start <= current_timestamp && current_timestamp <= trn_itr->timestamp_end, "The tournament is not running.");
+   check(roundOf(*trn_itr).status == ROUND_OPEN, "The tournament has already been paid out.");
+
+   entries_t entries = entries_t(get_self(), tournament_id);
+   scores_t players = scores_t(get_self(), tournament_id);
+   leaderboard_t leaderboard = leaderboard_t(get_self(), tournament_id);
+
+   round_state round = roundOf(*trn_itr);
+   uint32_t ranked = round.ranked;
+
+   for (const auto& [account, score] : scores) {
+
+      // only players that met the entry requirements of this round can score
+      if (trn_itr->requeriment_fee.has_value() || trn_itr->requeriment_nft.has_value()) {
+         auto ent_itr = entries.find(account.value);
+         INSTRUMENT_OP("entries", finds);
+
+         checkLazy(ent_itr != entries.end() && ent_itr->round_start == trn_itr->timestamp_start, [&]() { return "Account " + account.to_string() + " has not joined the tournament."; });
+      }
+
+      auto scr_itr = players.find(account.value);
+      INSTRUMENT_OP("scores", finds);
+
+      if (scr_itr == players.end()) {
+         scr_itr = players.emplace(CONTRACTN, [&](auto& scr) {
+            scr.account = account;
+            scr.round_start = trn_itr->timestamp_start;
+            scr.timestamp = current_timestamp;
+            scr.best = score;
+         });
+         INSTRUMENT_WRITE("scores", emplaces, *scr_itr);
+      } else if (scr_itr->round_start != trn_itr->timestamp_start || scr_itr->best < score) {
+         players.modify(scr_itr, CONTRACTN, [&](auto& scr) {
+            scr.round_start = trn_itr->timestamp_start;
+            scr.timestamp = current_timestamp;
+            scr.best = score;
+         });
+         INSTRUMENT_WRITE("scores", modifies, *scr_itr);
+      } else {
+         continue;
+      }
+
+      rankScore(leaderboard, round, account, score, current_timestamp);
+   }
+
+   // the row is only written when the leaderboard grew
+   if (round.ranked != ranked) {
+      trn_table.modify(trn_itr, CONTRACTN, [&](auto& trn) {
+         trn.round = round;
+      });
+      INSTRUMENT_WRITE("tournaments2", modifies, *trn_itr);
+   }
 }
 
 /**
-*  Removes a special creator
-*  @required_auth self
+*  Pays up to max_winners of the leaderboard of a finished tournament, best first, resuming from 
+*  the previous call. The last call returns what is left of the prize pot and the entry fees to 
+*  the creator funds, later calls do nothing
+*  @required_auth The contract itself
 */
-ACTION clashdometrn::rmcreator(
-   name creator
+ACTION clashdometrn::payout(
+   uint64_t tournament_id,
+   uint64_t max_winners
 )
 {
 
+   INSTRUMENT_ACTION("payout");
+
    require_auth(get_self());
 
-   auto cr_itr = creators.find(creator.value);
+   check(max_winners > 0, "max_winners has to be greater than 0.");
 
-   check(cr_itr != creators.end(), "Creator " + creator.to_string() + " doesn't exists.");
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
 
-   creators.erase(cr_itr);
-}
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
 
-void clashdometrn::addtrnfunds(
-   asset quantity,
-   name contract
-) {
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
 
-   require_auth(get_self());
+   check(trn_itr->timestamp_end < current_timestamp, "The tournament has not finished yet.");
+
+   round_state round = roundOf(*trn_itr);
+
+   if (round.status == ROUND_PAID) {
+      return;
+   }
 
-   auto cr_itr = creators.find(get_self().value);
+   // the number of winners is fixed by the first call, so every chunk uses the same weights
+   if (round.status == ROUND_OPEN) {
+      round.status = ROUND_PAYING;
+      round.winners = round.ranked;
+   }
 
-   check(cr_itr != creators.end(), "Invalid creator " + get_self().to_string());
+   leaderboard_t leaderboard = leaderboard_t(get_self(), tournament_id);
+   auto rank_idx = leaderboard.get_index<name("byrank")>();
+   auto brd_itr = rank_idx.begin();
+   INSTRUMENT_OP("leaderboard", finds);
 
-   config_s current_config = config.get();
+   name contract = potContract(*trn_itr);
 
-   bool is_fee_supported = false;
-   
-   for (extended_symbol supported_token_fee : current_config.supported_tokens_fee) {
-      if (supported_token_fee.get_symbol() == quantity.symbol && supported_token_fee.get_contract() == contract) {
-         is_fee_supported = true;
-         break;
+   check(contract != name() || round.pot.amount == 0, "Token not supported.");
+
+   // linear weights, rank r of n winners gets (n - r) / (n (n + 1) / 2) of the pot
+   uint128_t weights = (uint128_t) round.winners * (round.winners + 1) / 2;
+
+   for (uint64_t visited = 0; visited < max_winners && brd_itr != rank_idx.end(); visited++) {
+
+      INSTRUMENT_OP("leaderboard", steps);
+
+      asset prize = asset((uint128_t) round.pot.amount * (round.winners - round.paid) / weights, round.pot.symbol);
+
+      round.paid++;
+
+      // leaderboard rows are unique per account, so each winner gets a single transfer
+      if (prize.amount > 0) {
+         payOut(extended_asset(prize, contract), brd_itr->account, "Prize of tournament " + to_string(tournament_id) + ", rank " + to_string(round.paid));
+
+         round.distributed += prize;
       }
+
+      brd_itr = rank_idx.erase(brd_itr);
+      INSTRUMENT_OP("leaderboard", erases);
+      round.ranked--;
    }
 
-   for (extended_symbol supported_token_fee : cr_itr->supported_tokens_fee) {
-      if (supported_token_fee.get_symbol() == quantity.symbol && supported_token_fee.get_contract() == contract) {
-         is_fee_supported = true;
-         break;
+   // rounding leftovers and whatever the pot didn't use go back to the creator
+   if (round.ranked == 0) {
+      round.status = ROUND_PAID;
+
+      asset remainder = trn_itr->prize_pot + round.collected - round.distributed;
+
+      if (remainder.amount > 0) {
+         addBalance(trn_itr->creator, remainder, contract);
       }
    }
 
-   check (is_fee_supported, "Token not supported.");
+   trn_table.modify(trn_itr, CONTRACTN, [&](auto& trn) {
+      trn.round = round;
+   });
+   INSTRUMENT_WRITE("tournaments2", modifies, *trn_itr);
+}
+
+/**
+*  Settles a finished tournament with the merkle root of its results, winners then claim their 
+*  prizes. What the results don't pay of the prize pot and the entry fees goes back to the creator funds
+*  @required_auth The oracle permission of the contract
+*/
+ACTION clashdometrn::commitres(
+   uint64_t tournament_id,
+   checksum256 merkle_root,
+   asset total_payout
+)
+{
+
+   INSTRUMENT_ACTION("commitres");
+
+   require_auth(permission_level{get_self(), name("oracle")});
+
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   check(trn_itr->timestamp_end < current_timestamp, "The tournament has not finished yet.");
+
+   round_state round = roundOf(*trn_itr);
+
+   check(round.status == ROUND_OPEN, "The tournament has already been paid out.");
+   check(round.ranked == 0, "The tournament has a leaderboard, use payout.");
+   check(total_payout.symbol == round.pot.symbol && total_payout.amount >= 0 && total_payout <= round.pot, "The total payout has to be within the prize pot.");
+
+   name contract = potContract(*trn_itr);
+
+   check(contract != name() || total_payout.amount == 0, "Token not supported.");
+
+   if (total_payout.amount > 0) {
+      results_t results = results_t(get_self(), tournament_id);
+
+      auto res_itr = results.emplace(CONTRACTN, [&](auto& res) {
+         res.round_start = trn_itr->timestamp_start;
+         res.root = merkle_root;
+         res.total = extended_asset(total_payout, contract);
+         res.claimed = asset(0, total_payout.symbol);
+         res.creator = trn_itr->creator;
+         res.expires = current_timestamp + CLAIM_PERIOD;
+      });
+      INSTRUMENT_WRITE("results", emplaces, *res_itr);
+   }
+
+   round.status = ROUND_PAID;
+   round.distributed = total_payout;
+
+   asset remainder = trn_itr->prize_pot + round.collected - round.distributed;
+
+   if (remainder.amount > 0) {
+      addBalance(trn_itr->creator, remainder, contract);
+   }
+
+   trn_table.modify(trn_itr, CONTRACTN, [&](auto& trn) {
+      trn.round = round;
+   });
+   INSTRUMENT_WRITE("tournaments2", modifies, *trn_itr);
+}
+
+/**
+*  Pays the prize of a leaf of the committed results of a round, proven against its merkle root
+*  @required_auth The winner
+*/
+ACTION clashdometrn::claim(
+   uint64_t tournament_id,
+   uint32_t round_start,
+   name account,
+   asset amount,
+   uint32_t index,
+   vector <checksum256> proof
+)
+{
+
+   INSTRUMENT_ACTION("claim");
+
+   require_auth(account);
+
+   check(proof.size() <= 32, "Invalid proof.");
+
+   results_t results = results_t(get_self(), tournament_id);
+
+   auto res_itr = results.require_find(round_start, "No results for this tournament round.");
+   INSTRUMENT_OP("results", finds);
+
+   check(eosio::current_time_point().sec_since_epoch() <= res_itr->expires, "The claim period of this tournament round is over.");
+
+   checksum256 node = resultsLeaf(tournament_id, round_start, index, account, amount);
+
+   for (size_t level = 0; level < proof.size(); level++) {
+      node = (index >> level & 1) == 0 ? resultsParent(node, proof[level]) : resultsParent(proof[level], node);
+   }
+
+   check(node == res_itr->root, "Invalid proof.");
+
+   claims_t claims = claims_t(get_self(), tournament_id);
+
+   uint64_t word = ((uint64_t) round_start << 32) | (index / 64);
+   uint64_t bit = (uint64_t) 1 << (index % 64);
+
+   auto clm_itr = claims.find(word);
+   INSTRUMENT_OP("claims", finds);
+
+   if (clm_itr == claims.end()) {
+      clm_itr = claims.emplace(CONTRACTN, [&](auto& clm) {
+         clm.word = word;
+         clm.bits = bit;
+      });
+      INSTRUMENT_WRITE("claims", emplaces, *clm_itr);
+   } else {
+      check((clm_itr->bits & bit) == 0, "Prize already claimed.");
+
+      claims.modify(clm_itr, CONTRACTN, [&](auto& clm) {
+         clm.bits |= bit;
+      });
+      INSTRUMENT_WRITE("claims", modifies, *clm_itr);
+   }
+
+   check(amount.symbol == res_itr->claimed.symbol && amount.amount > 0 && res_itr->claimed + amount <= res_itr->total.quantity, "Invalid claim amount.");
+
+   payOut(extended_asset(amount, res_itr->total.contract), account, "Prize of tournament " + to_string(tournament_id));
+
+   // fully claimed results are no longer needed, the bitmap keeps rejecting repeated leaves
+   if (res_itr->claimed + amount == res_itr->total.quantity) {
+      results.erase(res_itr);
+      INSTRUMENT_OP("results", erases);
+      return;
+   }
+
+   results.modify(res_itr, CONTRACTN, [&](auto& res) {
+      res.claimed += amount;
+   });
+   INSTRUMENT_WRITE("results", modifies, *res_itr);
+}
+
+/**
+*  Erases up to max_rows expired results of a tournament, returning what wasn't claimed to the creator funds, 
+*  and the claims of rounds that no longer have results
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::pruneresults(
+   uint64_t tournament_id,
+   uint64_t max_rows
+)
+{
+
+   INSTRUMENT_ACTION("pruneresults");
+
+   require_auth(get_self());
+
+   check(max_rows > 0, "max_rows has to be greater than 0.");
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   results_t results = results_t(get_self(), tournament_id);
+   claims_t claims = claims_t(get_self(), tournament_id);
+
+   auto res_itr = results.begin();
+   INSTRUMENT_OP("results", finds);
+
+   uint64_t visited = 0;
+
+   for (; visited < max_rows && res_itr != results.end(); visited++) {
+
+      INSTRUMENT_OP("results", steps);
+
+      if (res_itr->expires >= current_timestamp) {
+         res_itr++;
+         continue;
+      }
+
+      asset unclaimed = res_itr->total.quantity - res_itr->claimed;
+
+      // funds of purged creators stay with the contract, or with clashdomepay when the contract funds 
+      // of the symbol are held in tokens of another contract
+      if (unclaimed.amount > 0) {
+         if (findCreator(res_itr->creator) != nullptr) {
+            addBalance(res_itr->creator, unclaimed, res_itr->total.contract);
+         } else {
+            tryAddBalance(get_self(), unclaimed, res_itr->total.contract);
+         }
+      }
+
+      res_itr = results.erase(res_itr);
+      INSTRUMENT_OP("results", erases);
+   }
+
+   // claims share the budget once the results are done, the words of a round are contiguous
+   auto clm_itr = claims.begin();
+   INSTRUMENT_OP("claims", finds);
+
+   for (; visited < max_rows && clm_itr != claims.end(); visited++) {
+
+      INSTRUMENT_OP("claims", steps);
+
+      uint32_t round_start = clm_itr->word >> 32;
+
+      INSTRUMENT_OP("results", finds);
+
+      if (results.find(round_start) != results.end()) {
+         clm_itr = round_start == UINT32_MAX ? claims.end() : claims.lower_bound((uint64_t) (round_start + 1) << 32);
+         INSTRUMENT_OP("claims", finds);
+         continue;
+      }
+
+      clm_itr = claims.erase(clm_itr);
+      INSTRUMENT_OP("claims", erases);
+   }
+}
+
+/**
+*  Erases up to max_rows entries and scores of a tournament that no longer exists or of its previous rounds, 
+*  and returns the nfts locked for finished rounds
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::pruneentries(
+   uint64_t tournament_id,
+   uint64_t max_rows
+)
+{
+
+   INSTRUMENT_ACTION("pruneentries");
+
+   require_auth(get_self());
+
+   check(max_rows > 0, "max_rows has to be greater than 0.");
+
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = trn_table.find(tournament_id);
+   INSTRUMENT_OP("tournaments2", finds);
+
+   // a row is current while it belongs to the running round of an existing tournament
+   auto stale = [&](uint32_t round_start) {
+      return trn_itr == trn_table.end() || round_start != trn_itr->timestamp_start;
+   };
+
+   entries_t entries = entries_t(get_self(), tournament_id);
+   scores_t players = scores_t(get_self(), tournament_id);
+
+   auto ent_itr = entries.begin();
+   INSTRUMENT_OP("entries", finds);
+
+   uint64_t visited = 0;
+
+   for (; visited < max_rows && ent_itr != entries.end(); visited++) {
+
+      INSTRUMENT_OP("entries", steps);
+
+      if (!stale(ent_itr->round_start)) {
+         ent_itr++;
+         continue;
+      }
+
+      ent_itr = entries.erase(ent_itr);
+      INSTRUMENT_OP("entries", erases);
+   }
+
+   // scores share the budget once the entries are done
+   auto scr_itr = players.begin();
+   INSTRUMENT_OP("scores", finds);
+
+   for (; visited < max_rows && scr_itr != players.end(); visited++) {
+
+      INSTRUMENT_OP("scores", steps);
+
+      if (!stale(scr_itr->round_start)) {
+         scr_itr++;
+         continue;
+      }
+
+      scr_itr = players.erase(scr_itr);
+      INSTRUMENT_OP("scores", erases);
+   }
+
+   // locked nfts go back once their round has finished, grouped in one transfer per account
+   nftlocks_t nftlocks = nftlocks_t(get_self(), tournament_id);
+   std::map <name, vector <uint64_t>> unlocked;
+
+   bool finished = trn_itr == trn_table.end() || trn_itr->timestamp_end < eosio::current_time_point().sec_since_epoch();
+
+   auto lck_itr = nftlocks.begin();
+   INSTRUMENT_OP("nftlocks", finds);
+
+   for (; visited < max_rows && lck_itr != nftlocks.end(); visited++) {
+
+      INSTRUMENT_OP("nftlocks", steps);
+
+      if (!finished && !stale(lck_itr->round_start)) {
+         lck_itr++;
+         continue;
+      }
+
+      unlocked[lck_itr->account].push_back(lck_itr->asset_id);
+
+      lck_itr = nftlocks.erase(lck_itr);
+      INSTRUMENT_OP("nftlocks", erases);
+   }
+
+   for (const auto& [account, asset_ids] : unlocked) {
+      action(
+         permission_level{get_self(), name("active")},
+         name("atomicassets"),
+         name("transfer"),
+         std::make_tuple(
+            get_self(),
+            account,
+            asset_ids,
+            "Unlocked from tournament " + to_string(tournament_id)
+         )
+      ).send();
+      INSTRUMENT_INLINE();
+   }
+}
+
+/**
+*  Logs a moderation action over an account of a tournament
+*  @required_auth The tournament creator
+*/
+ACTION clashdometrn::rmusertrn(
+   name creator,
+   name account,
+   uint64_t tournament_id,
+   string type
+)
+{
+
+   INSTRUMENT_ACTION("rmusertrn");
+
+   require_auth(creator);
+
+   addModerationRecords(creator, tournament_id, {account}, type);
+}
+
+/**
+*  Logs a moderation action over several accounts of a tournament
+*  @required_auth The tournament creator
+*/
+ACTION clashdometrn::rmusertrns(
+   name creator,
+   uint64_t tournament_id,
+   vector <name> accounts,
+   string type
+)
+{
+
+   INSTRUMENT_ACTION("rmusertrns");
+
+   require_auth(creator);
+
+   check(!accounts.empty(), "No accounts to remove.");
+
+   addModerationRecords(creator, tournament_id, accounts, type);
+}
+
+/**
+*  Erases up to max_rows moderation records of a tournament older than the retention window. 
+*  The sequence counter of a tournament that no longer exists goes with its last record
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::prunemodlog(
+   uint64_t tournament_id,
+   uint64_t max_rows
+)
+{
+
+   INSTRUMENT_ACTION("prunemodlog");
+
+   require_auth(get_self());
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   modlog_t modlog = modlog_t(get_self(), tournament_id);
+
+   pruneModerationRecords(modlog, current_timestamp, max_rows);
+
+   if (modlog.begin() != modlog.end()) {
+      return;
+   }
+
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+   INSTRUMENT_OP("tournaments2", finds);
+
+   auto seq_itr = modseqs.find(tournament_id);
+   INSTRUMENT_OP("modseqs", finds);
+
+   if (seq_itr != modseqs.end() && trn_table.find(tournament_id) == trn_table.end()) {
+      modseqs.erase(seq_itr);
+      INSTRUMENT_OP("modseqs", erases);
+   }
+}
+
+/**
+*  Adds a special creator
+*  @required_auth self
+*/
+ACTION clashdometrn::addcreator(
+   name creator,
+   string img,
+   vector <extended_symbol> supported_tokens_fee,
+   bool stake_available,
+   vector <extended_symbol> supported_tokens_stake,
+   bool nft_available,
+   bool pot_available
+)
+{
+
+   INSTRUMENT_ACTION("addcreator");
+
+   require_auth(get_self());
+
+   checkLazy(findCreator(creator) == nullptr, [&]() { return "Creator " + creator.to_string() + " already exists."; });
+
+   creators_s crt;
+   crt.creator = creator;
+   setString(crt.img, crt.img_ref, img);
+   crt.stake_available = stake_available;
+   crt.nft_available = nft_available;
+   crt.pot_available = pot_available;
+
+   emplaceCreator(crt);
+
+   for (const extended_symbol& token : supported_tokens_fee) {
+      addToken(creator, token, TOKEN_FEE);
+   }
+
+   for (const extended_symbol& token : supported_tokens_stake) {
+      addToken(creator, token, TOKEN_STAKE);
+   }
+}
+
+/**
+*  Edit a creator img
+*  @required_auth self
+*/
+ACTION clashdometrn::editcrimg(
+         name creator,
+         string img
+      )
+{
+   INSTRUMENT_ACTION("editcrimg");
+
+   require_auth(creator);
+
+   checkLazy(findCreator(creator) != nullptr, [&]() { return "Creator " + creator.to_string() + " doesn't exists."; });
+
+   creators_s& crt = editCreator(creator);
+
+   setString(crt.img, crt.img_ref, img);
+}
+
+/**
+*  Removes a special creator
+*  @required_auth self
+*/
+ACTION clashdometrn::rmcreator(
+   name creator
+)
+{
+
+   INSTRUMENT_ACTION("rmcreator");
+
+   require_auth(get_self());
+
+   checkLazy(findCreator(creator) != nullptr, [&]() { return "Creator " + creator.to_string() + " doesn't exists."; });
+
+   check(!hasTournaments(creator), "The creator still has tournaments or funds, use purgecreator.");
+
+   // rows spent down to zero are kept by the row cache, only the amounts count
+   balances_t balances = balances_t(get_self(), creator.value);
+   INSTRUMENT_OP("balances", finds);
+
+   for (auto bal_itr = balances.begin(); bal_itr != balances.end();) {
+      check(bal_itr->funds.amount == 0, "The creator still has tournaments or funds, use purgecreator.");
+
+      bal_itr = balances.erase(bal_itr);
+      INSTRUMENT_OP("balances", erases);
+   }
+
+   eraseCreator(creator);
+
+   tokens_t creator_tokens = tokens_t(get_self(), creator.value);
+
+   for (auto tkn_itr = creator_tokens.begin(); tkn_itr != creator_tokens.end();) {
+      tkn_itr = creator_tokens.erase(tkn_itr);
+      INSTRUMENT_OP("tokens", erases);
+   }
+}
+
+/**
+*  Removes a creator in bounded steps: erases its settled tournaments refunding the prize pot of 
+*  those not finished, sends its funds back, erases its tokens and finally the creator. Each call 
+*  visits up to max_rows rows and resumes where the previous one stopped. Tournaments waiting for 
+*  their payout are kept, and the creator with them, until they are settled
+*  @required_auth self
+*/
+ACTION clashdometrn::purgecreator(
+   name creator,
+   uint64_t max_rows
+)
+{
+
+   INSTRUMENT_ACTION("purgecreator");
+
+   require_auth(get_self());
+
+   check(max_rows > 0, "max_rows has to be greater than 0.");
+
+   auto prg_itr = purges.find(creator.value);
+   INSTRUMENT_OP("purges", finds);
+
+   if (prg_itr == purges.end()) {
+      checkLazy(findCreator(creator) != nullptr, [&]() { return "Creator " + creator.to_string() + " doesn't exists."; });
+
+      prg_itr = purges.emplace(CONTRACTN, [&](auto& prg) {
+         prg.creator = creator;
+         prg.stage = PURGE_TOURNAMENTS;
+         prg.cursor = 0;
+      });
+      INSTRUMENT_WRITE("purges", emplaces, *prg_itr);
+   }
+
+   purges_s purge = *prg_itr;
+   uint64_t visited = 0;
+
+   if (purge.stage == PURGE_TOURNAMENTS) {
+      uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+      vector <archived_tournament> archived;
+
+      // resume after the last tournament kept, in its scope, unless it has been erased since
+      tournaments_t* kept_table = nullptr;
+      const tournaments_s* kept = nullptr;
+
+      if (purge.cursor != 0) {
+         kept_table = &tournamentsFor(purge.cursor);
+
+         auto kept_itr = kept_table->find(purge.cursor);
+         INSTRUMENT_OP("tournaments2", finds);
+
+         kept = kept_itr != kept_table->end() ? &*kept_itr : nullptr;
+      }
+
+      bool walked = true;
+
+      for (uint64_t scope : tournamentScopes()) {
+
+         tournaments_t& trn_table = tournamentsIn(scope);
+
+         if (kept != nullptr && kept_table != &trn_table) {
+            continue;
+         }
+
+         auto trn_idx = trn_table.get_index<name("bycreator")>();
+         auto trn_itr = kept != nullptr ? ++trn_idx.iterator_to(*kept) : trn_idx.lower_bound(creatorKey(creator, 0));
+         INSTRUMENT_OP("tournaments2", finds);
+
+         kept = nullptr;
+
+         for (; visited < max_rows && trn_itr != trn_idx.end() && trn_itr->creator == creator; visited++) {
+
+            INSTRUMENT_OP("tournaments2", steps);
+
+            if (!isSettled(*trn_itr)) {
+               purge.cursor = trn_itr->tournament_id;
+               trn_itr++;
+               continue;
+            }
+
+            // finished tournaments are archived as in prunetrn, the others are cancelled
+            if (trn_itr->timestamp_end < current_timestamp) {
+               archived.push_back(archived_tournament{
+                  trn_itr->tournament_id,
+                  trn_itr->creator,
+                  trn_itr->game,
+                  trn_itr->timestamp_start,
+                  trn_itr->timestamp_end,
+                  trn_itr->prize_pot
+               });
+            }
+
+            releasePot(*trn_itr);
+
+            eraseTournamentGame(trn_itr->tournament_id);
+            releaseString(trn_itr->name_ref.value_or(0));
+
+            trn_itr = trn_idx.erase(trn_itr);
+            INSTRUMENT_OP("tournaments2", erases);
+         }
+
+         if (trn_itr != trn_idx.end() && trn_itr->creator == creator) {
+            walked = false;
+            break;
+         }
+      }
+
+      // once every scope has been walked, the stage is done when no tournament is left
+      if (walked) {
+         if (!hasTournaments(creator)) {
+            purge.stage = PURGE_BALANCES;
+         }
+
+         purge.cursor = 0;
+      }
+
+      if (!archived.empty()) {
+         action(
+            permission_level{get_self(), name("active")},
+            get_self(),
+            name("logprunetrn"),
+            std::make_tuple(archived)
+         ).send();
+         INSTRUMENT_INLINE();
+      }
+   }
+
+   if (purge.stage == PURGE_BALANCES) {
+      // refunds above are still in the row cache
+      flushCache();
+
+      balances_t balances = balances_t(get_self(), creator.value);
+
+      auto bal_itr = balances.begin();
+      INSTRUMENT_OP("balances", finds);
+
+      for (; visited < max_rows && bal_itr != balances.end(); visited++) {
+
+         INSTRUMENT_OP("balances", steps);
+
+         if (bal_itr->funds.amount > 0) {
+            name contract = bal_itr->contract.value_or(name());
+
+            payOut(extended_asset(bal_itr->funds, contract != name() ? contract : tokenContract(creator, bal_itr->funds.symbol)), creator, "Refund of creator funds");
+         }
+
+         bal_itr = balances.erase(bal_itr);
+         INSTRUMENT_OP("balances", erases);
+      }
+
+      if (bal_itr == balances.end()) {
+         purge.stage = PURGE_TOKENS;
+      }
+   }
+
+   if (purge.stage == PURGE_TOKENS) {
+      tokens_t creator_tokens = tokens_t(get_self(), creator.value);
+
+      auto tkn_itr = creator_tokens.begin();
+      INSTRUMENT_OP("tokens", finds);
+
+      for (; visited < max_rows && tkn_itr != creator_tokens.end(); visited++) {
+         INSTRUMENT_OP("tokens", steps);
+
+         tkn_itr = creator_tokens.erase(tkn_itr);
+         INSTRUMENT_OP("tokens", erases);
+      }
+
+      if (tkn_itr == creator_tokens.end()) {
+         balances_t balances = balances_t(get_self(), creator.value);
+         INSTRUMENT_OP("balances", finds);
+
+         // expired results or migratefnds may have credited the creator since the balances stage, and 
+         // migratetrn may have moved tournaments in
+         if (hasTournaments(creator)) {
+            purge.stage = PURGE_TOURNAMENTS;
+         } else if (balances.begin() != balances.end()) {
+            purge.stage = PURGE_BALANCES;
+         } else {
+            if (findCreator(creator) != nullptr) {
+               eraseCreator(creator);
+            }
+
+            purges.erase(prg_itr);
+            INSTRUMENT_OP("purges", erases);
+            return;
+         }
+      }
+   }
+
+   purges.modify(prg_itr, CONTRACTN, [&](auto& prg) {
+      prg = purge;
+   });
+   INSTRUMENT_WRITE("purges", modifies, *prg_itr);
+}
+
+void clashdometrn::addtrnfunds(
+   asset quantity,
+   name contract
+) {
+
+   INSTRUMENT_ACTION("addtrnfunds");
+
+   require_auth(get_self());
+
+   checkLazy(findCreator(get_self()) != nullptr, [&]() { return "Invalid creator " + get_self().to_string(); });
+
+   checkNotPurged(get_self());
+
+   check(isTokenSupported(get_self(), extended_symbol(quantity.symbol, contract), TOKEN_FEE), "Token not supported.");
+
+   addBalance(get_self(), quantity, contract);
+
+   accrueDeposit(contract, quantity, "Add funds from " + get_self().to_string());
+}
+
+/**
+*  Sets the pending amount of a token that triggers a sweep to clashdomepay. 
+*  With a zero threshold every deposit is sent right away
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::setsweep(
+   extended_symbol token,
+   asset threshold
+) {
+
+   INSTRUMENT_ACTION("setsweep");
+
+   require_auth(get_self());
+
+   check(threshold.symbol == token.get_symbol() && threshold.amount >= 0, "Invalid threshold.");
+
+   sweeps_t sweeps = sweeps_t(get_self(), token.get_contract().value);
+
+   auto swp_itr = findSweep(sweeps, token);
+
+   sweeps.modify(swp_itr, CONTRACTN, [&](auto& swp) {
+      swp.threshold = threshold;
+   });
+   INSTRUMENT_WRITE("sweeps", modifies, *swp_itr);
+}
+
+/**
+*  Sends the pending deposits of a token to clashdomepay in a single transfer, 
+*  at most max_quantity when its amount is not zero
+*  @required_auth The contract itself
+*/
+ACTION clashdometrn::sweep(
+   extended_symbol token,
+   asset max_quantity
+) {
+
+   INSTRUMENT_ACTION("sweep");
+
+   require_auth(get_self());
+
+   check(max_quantity.symbol == token.get_symbol() && max_quantity.amount >= 0, "Invalid quantity.");
+
+   sweeps_t sweeps = sweeps_t(get_self(), token.get_contract().value);
+
+   auto swp_itr = sweeps.require_find(token.get_symbol().raw(), "Nothing to sweep.");
+   INSTRUMENT_OP("sweeps", finds);
+   check(swp_itr->token == token && swp_itr->pending.amount > 0, "Nothing to sweep.");
+
+   sweeps.modify(swp_itr, CONTRACTN, [&](auto& swp) {
+      asset quantity = max_quantity.amount > 0 && max_quantity < swp.pending ? max_quantity : swp.pending;
+      sweepPending(swp, quantity, "Sweep from " + get_self().to_string());
+   });
+   INSTRUMENT_WRITE("sweeps", modifies, *swp_itr);
+}
+
+// QUERY ACTIONS
+
+/**
+*  Lists the tournaments starting at or after from_ts (now when 0) in start time order, 
+*  only for the given game unless it is 0. With per-game scopes, all games are listed one 
+*  game after the other. Doesn't modify any table
+*/
+clashdometrn::trn_page clashdometrn::listupcoming(
+   uint64_t game,
+   uint64_t from_ts,
+   uint64_t limit,
+   uint128_t cursor
+) {
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   from_ts = from_ts == 0 ? current_timestamp : from_ts;
+
+   auto all_games = [](const tournaments_s&) { return true; };
+
+   // positions are (timestamp_start, tournament_id), the start of the range when before from_ts
+   auto start_position = [](const tournaments_s& trn) {
+      return startKey(trn.timestamp_start, trn.tournament_id);
+   };
+
+   uint128_t from_position = startKey(from_ts, 0);
+
+   if (game == 0) {
+      return fillScopesPage(cursor, limit, [&](tournaments_t& trn_table, uint128_t resume, uint64_t page_limit) {
+         auto trn_idx = trn_table.get_index<name("bystarttime")>();
+
+         return fillPage(trn_idx, trn_idx.lower_bound(std::max(resume, from_position)), page_limit, current_timestamp, all_games, all_games, start_position);
+      });
+   }
+
+   // a single game is a contiguous range of the game index
+   auto trn_idx = tournamentsOf(game).get_index<name("bygamestart")>();
+
+   uint128_t game_key = gameStartKey(game, 0, 0);
+
+   return fillPage(trn_idx, trn_idx.lower_bound(game_key | std::max(cursor & CURSOR_POSITION, from_position)), limit, current_timestamp, [&](const tournaments_s& trn) {
+      return trn.game == game;
+   }, all_games, start_position);
+}
+
+/**
+*  Lists the tournaments of a creator in the given phase, any phase when status is 0. 
+*  Doesn't modify any table
+*/
+clashdometrn::trn_page clashdometrn::listbycr(
+   name creator,
+   uint8_t status,
+   uint64_t limit,
+   uint128_t cursor
+) {
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   // positions are tournament ids, the creator is the rest of the index key
+   return fillScopesPage(cursor, limit, [&](tournaments_t& trn_table, uint128_t resume, uint64_t page_limit) {
+      auto trn_idx = trn_table.get_index<name("bycreator")>();
+
+      return fillPage(trn_idx, trn_idx.lower_bound(creatorKey(creator, resume > UINT64_MAX ? UINT64_MAX : (uint64_t) resume)), page_limit, current_timestamp, [&](const tournaments_s& trn) {
+         return trn.creator == creator;
+      }, [&](const tournaments_s& trn) {
+         return status == ANY_PHASE || phaseOf(trn, current_timestamp) == status;
+      }, [](const tournaments_s& trn) {
+         return (uint128_t) trn.tournament_id;
+      });
+   });
+}
+
+/**
+*  Returns a creator with its balances and supported tokens. Doesn't modify any table
+*/
+clashdometrn::creator_info clashdometrn::getcreator(
+   name creator
+) {
+
+   auto cr_itr = creators.require_find(creator.value, "Invalid creator username");
+   INSTRUMENT_OP("creators", finds);
+
+   creator_info info = {
+      cr_itr->creator,
+      stringOf(cr_itr->img, cr_itr->img_ref),
+      cr_itr->stake_available,
+      cr_itr->nft_available,
+      cr_itr->pot_available,
+      {},
+      {},
+      {}
+   };
+
+   balances_t balances = balances_t(get_self(), creator.value);
+
+   for (const balances_s& bal : balances) {
+      INSTRUMENT_OP("balances", steps);
+      info.funds.push_back(bal.funds);
+   }
+
+   tokens_t creator_tokens = tokens_t(get_self(), creator.value);
+
+   for (const tokens_s& tkn : creator_tokens) {
+      INSTRUMENT_OP("tokens", steps);
+
+      if (tkn.type & TOKEN_FEE) {
+         info.supported_tokens_fee.push_back(tkn.token);
+      }
+      if (tkn.type & TOKEN_STAKE) {
+         info.supported_tokens_stake.push_back(tkn.token);
+      }
+   }
+
+   return info;
+}
+
+// LOG ACTIONS
+
+ACTION clashdometrn::logcreatetrn(
+   uint64_t tournament_id, 
+   name creator,
+   string name,
+   uint64_t game,
+   uint64_t timestamp_start, 
+   uint64_t timestamp_end,
+   asset requeriment_fee,
+   asset requeriment_stake,
+   string requeriment_nft,
+   asset prize_pot,
+   string type_prize_pot,
+   bool recreate
+) {
+   
+   require_auth(get_self());
+}
+
+ACTION clashdometrn::logprunetrn(
+   vector <archived_tournament> tournaments
+) {
+   
+   require_auth(get_self());
+}
+
+ACTION clashdometrn::logtknskip(
+   vector <skipped_token> tokens
+) {
+   
+   require_auth(get_self());
+}
+
+ACTION clashdometrn::lognftdrop(
+   vector <dropped_nft> requirements
+) {
+   
+   require_auth(get_self());
+}
+
+ACTION clashdometrn::logstats(
+   name action,
+   vector <table_stats> tables,
+   uint32_t inline_actions
+) {
+   
+   require_auth(get_self());
+}
+
+// NOTIFY
+void clashdometrn::receive_nft(
+   name from,
+   name to,
+   const vector <uint64_t>& asset_ids,
+   const string& memo
+) {
+
+   std::string_view argument;
+
+   // nfts sent for anything but joining are left alone
+   if (to != get_self() || toMemoCommand(memo, argument) != MEMO_JOIN) {
+      return;
+   }
+
+   INSTRUMENT_ACTION("nfttransfer");
+
+   lockNfts(from, toNumber(argument, UINT64_MAX, "Invalid tournament id."), asset_ids);
+}
+
+void clashdometrn::receive_transfer(
+   name from,
+   name to,
+   const asset& quantity,
+   const string& memo
+) {
+
+   if (to != get_self()) {
+      return;
+   }
+
+   std::string_view argument;
+   uint8_t command = toMemoCommand(memo, argument);
+
+   if (command == MEMO_ADD_TOKENS) {
+      return;
+   }
+
+   INSTRUMENT_ACTION("transfer");
+
+   name contract = get_first_receiver();
+
+   if (command == MEMO_JOIN) {
+      joinTournament(from, toNumber(argument, UINT64_MAX, "Invalid tournament id."), extended_asset(quantity, contract));
+      return;
+   }
+
+   check(command == MEMO_ADD_FUNDS, "Memo has to be 'add-funds' or 'join:<tournament_id>'.");
+
+   checkLazy(findCreator(from) != nullptr, [&]() { return "Invalid creator " + from.to_string(); });
+
+   checkNotPurged(from);
+
+   check(isTokenSupported(from, extended_symbol(quantity.symbol, contract), TOKEN_FEE), "Token not supported.");
+
+   addBalance(from, quantity, contract);
+
+   accrueDeposit(contract, quantity, "Add funds from " + from.to_string());
+}
+
+// AUXILIAR FUNCTIONS
+void clashdometrn::checkPendingTournament(name creator, uint64_t timestamp_start, uint64_t timestamp_end, uint64_t game, uint64_t ignore_id)
+{
+   check(!hasPendingTournament(creator, timestamp_start, timestamp_end, game, ignore_id), "Two tournaments at same time are not allowed.");
+}
+
+void clashdometrn::checkNotPurged(name creator)
+{
+   // purgecreator erases the tournaments and balances it has walked, new ones would be left behind
+   check(purges.find(creator.value) == purges.end(), "The creator is being purged.");
+   INSTRUMENT_OP("purges", finds);
+}
+
+bool clashdometrn::hasPendingTournament(name creator, uint64_t timestamp_start, uint64_t timestamp_end, uint64_t game, uint64_t ignore_id)
+{
+   tournaments_t& trn_table = tournamentsOf(game);
+
+   // rows not moved yet by migratetrn are still in the legacy table
+   legacy_tournaments_t legacy_tournaments = legacy_tournaments_t(get_self(), get_self().value);
+
+   if (hasPendingTournamentIn(legacy_tournaments, creator, timestamp_start, timestamp_end, game, ignore_id)) {
+      return true;
+   }
+
+#ifdef CLASHDOME_GAME_SCOPES
+   // rows not moved yet by migratescope are still in the contract scope
+   if (&trn_table != &tournaments && hasPendingTournamentIn(tournaments, creator, timestamp_start, timestamp_end, game, ignore_id)) {
+      return true;
+   }
+#endif
+
+   return hasPendingTournamentIn(trn_table, creator, timestamp_start, timestamp_end, game, ignore_id);
+}
+
+template <typename Table>
+bool clashdometrn::hasPendingTournamentIn(Table& trn_table, name creator, uint64_t timestamp_start, uint64_t timestamp_end, uint64_t game, uint64_t ignore_id)
+{
+   // tournaments of the same creator and game never overlap, so ordered by end time they are also ordered 
+   // by start time: the first one ending at or after the new start is the only one that can collide
+   auto trn_idx = trn_table.template get_index<name("bycrgameend")>();
+   auto trn_itr = trn_idx.lower_bound(creatorGameEndKey(creator, game, timestamp_start));
+   INSTRUMENT_OP("tournaments2", finds);
+
+   // the tournament being edited can't collide with itself
+   if (trn_itr != trn_idx.end() && trn_itr->tournament_id == ignore_id) {
+      trn_itr++;
+      INSTRUMENT_OP("tournaments2", steps);
+   }
+
+   return trn_itr != trn_idx.end() && trn_itr->creator == creator && trn_itr->game == game && trn_itr->timestamp_start <= timestamp_end;
+}
+
+bool clashdometrn::rollTournament(tournaments_t& trn_table, const tournaments_s& trn, uint64_t current_timestamp)
+{
+   // a series repeats every whole number of days covering its duration, skipping the rounds already missed
+   uint64_t period = (trn.timestamp_end - trn.timestamp_start + RECREATE_PERIOD - 1) / RECREATE_PERIOD * RECREATE_PERIOD;
+   uint64_t offset = ((current_timestamp - trn.timestamp_end) / period + 1) * period;
+
+   uint64_t timestamp_start = trn.timestamp_start + offset;
+   uint64_t timestamp_end = trn.timestamp_end + offset;
+
+   if (timestamp_end > UINT32_MAX || hasPendingTournament(trn.creator, timestamp_start, timestamp_end, trn.game, trn.tournament_id)) {
+      return false;
+   }
+
+   // the pot of an unpaid round is still held and becomes the pot of the next one
+   if (roundOf(trn).status == ROUND_PAID && !trySubBalance(trn.creator, trn.prize_pot)) {
+      return false;
+   }
+
+   trn_table.modify(trn, CONTRACTN, [&](auto& row) {
+      row.timestamp_start = timestamp_start;
+      row.timestamp_end = timestamp_end;
+
+      // entries of the previous round become stale through their round_start
+      if (row.round.has_value()) {
+         row.round.reset();
+         row.round = roundOf(row);
+      }
+   });
+   INSTRUMENT_WRITE("tournaments2", modifies, trn);
+
+   return true;
+}
+
+void clashdometrn::createTournaments(name creator, const vector <tournament_spec>& specs)
+{
+   check(!specs.empty(), "No tournaments to create.");
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   const creators_s* cr = findCreator(creator);
+
+   // TODO: remove this after add permissions to create tournament with nft
+   check(cr != nullptr, "Invalid creator username");
+
+   checkNotPurged(creator);
+
+   vector <asset> prize_pots;
+
+   for (const tournament_spec& spec : specs) {
+
+      checkTournament(*cr, spec, current_timestamp);
+
+      // check tournaments in progress
+      checkPendingTournament(creator, spec.timestamp_start, spec.timestamp_end, spec.game, 0);
+
+      auto pot_itr = find_if(prize_pots.begin(), prize_pots.end(), [&](const asset& a) {
+         return a.symbol == spec.prize_pot.symbol;
+      });
+
+      if (pot_itr == prize_pots.end()) {
+         prize_pots.push_back(spec.prize_pot);
+      } else {
+         *pot_itr += spec.prize_pot;
+      }
+   }
+
+   // check tournaments in the batch, ordered by game and start time only neighbours can overlap
+   if (specs.size() > 1) {
+      vector <const tournament_spec*> sorted_specs;
+      sorted_specs.reserve(specs.size());
+
+      for (const tournament_spec& spec : specs) {
+         sorted_specs.push_back(&spec);
+      }
+
+      sort(sorted_specs.begin(), sorted_specs.end(), [](const tournament_spec* a, const tournament_spec* b) {
+         return a->game < b->game || (a->game == b->game && a->timestamp_start < b->timestamp_start);
+      });
+
+      for (size_t i = 1; i < sorted_specs.size(); i++) {
+         check(sorted_specs[i - 1]->game != sorted_specs[i]->game || sorted_specs[i - 1]->timestamp_end < sorted_specs[i]->timestamp_start, "Two tournaments at same time are not allowed.");
+      }
+   }
+
+   // check creator funds
+   for (const asset& prize_pot : prize_pots) {
+      subBalance(creator, prize_pot);
+   }
+
+   config_s& current_config = editConfig();
+
+   uint64_t tournament_id = current_config.tournament_counter;
+   current_config.tournament_counter += specs.size();
+
+   for (const tournament_spec& spec : specs) {
+      auto trn_itr = tournamentsOf(spec.game).emplace(CONTRACTN, [&](auto& trn) {
+         trn.tournament_id = tournament_id++;
+         trn.creator = creator;
+         setTournament(trn, spec);
+      });
+      INSTRUMENT_WRITE("tournaments2", emplaces, *trn_itr);
+
+      setTournamentGame(trn_itr->tournament_id, trn_itr->game);
+   }
+}
+
+void clashdometrn::checkTournament(const creators_s& creator, const tournament_spec& spec, uint64_t current_timestamp)
+{
+   const game_rules* rules = findGame(spec.game);
+
+   check(rules != nullptr, "Invalid game ID.");
+
+   // check timestamps
+   check(spec.timestamp_start >= current_timestamp, "The start time must be later than the current time.");
+   check(spec.timestamp_start < spec.timestamp_end, "The end time must be later than the start time.");
+
+   check(spec.timestamp_end <= UINT32_MAX, "The end time is too far in the future.");
+
+   uint64_t duration = spec.timestamp_end - spec.timestamp_start;
+
+   checkLazy(duration >= (uint64_t) rules->min_duration * 3600 && duration <= (uint64_t) rules->max_duration * 3600, [&]() { return "Duration must be between " + to_string(rules->min_duration) + " and " + to_string(rules->max_duration) + " hours."; });
+
+   // check fee and stake symbols
+   checkFeeAndStake(creator.creator, spec.requeriment_fee, spec.requeriment_stake);
+
+   // check prizepot
+   check(spec.prize_pot.is_valid() && spec.prize_pot.amount >= 0, "Invalid prize pot.");
+   check(spec.requeriment_fee.amount == 0 || spec.requeriment_fee.symbol == spec.prize_pot.symbol, "Entry fee and prize pot symbols are different");
+   check(spec.requeriment_fee.amount == 0 || spec.type_prize_pot == POT_MINIMUM || spec.type_prize_pot == POT_BONUS, "Invalid prize pot type.");
+   check((rules->pot_types >> toPotType(spec.type_prize_pot) & 1) != 0, "Prize pot type not allowed for this game.");
+
+   // check requeriment stake, nfts y pot
+   check(creator.stake_available || spec.requeriment_stake.amount == 0, "Requeriment stake is not allowed.");
+   check(creator.pot_available || spec.prize_pot.amount == 0, "Prize pot is not allowed.");
+   check(creator.nft_available || spec.requeriment_nft == "", "Requeriment NFT is not allowed.");
+   check(rules->nft_allowed || spec.requeriment_nft == "", "Requeriment NFT is not allowed for this game.");
+}
+
+void clashdometrn::setTournament(tournaments_s& trn, const tournament_spec& spec)
+{
+   // a round nothing happened in yet only holds defaults, it is derived again from the new pot
+   if (trn.round.has_value() && trn.round.value().status == ROUND_OPEN && trn.round.value().entries == 0 && trn.round.value().ranked == 0) {
+      trn.round.reset();
+   }
+
+   trn.version = TOURNAMENT_VERSION;
+   trn.game = spec.game;
+   trn.type_prize_pot = toPotType(spec.type_prize_pot);
+   trn.recreate = spec.recreate;
+   trn.timestamp_start = spec.timestamp_start;
+   trn.timestamp_end = spec.timestamp_end;
+   trn.prize_pot = spec.prize_pot;
+   trn.requeriment_fee = spec.requeriment_fee.amount != 0 ? std::optional <asset>(spec.requeriment_fee) : std::nullopt;
+   trn.requeriment_stake = spec.requeriment_stake.amount != 0 ? std::optional <asset>(spec.requeriment_stake) : std::nullopt;
+   trn.requeriment_nft = toNftRequirement(spec.requeriment_nft);
+
+   setString(trn.name, trn.name_ref, spec.name);
+
+   // the pot is taken from the creator funds and the fees have to be paid in the same tokens
+   trn.pot_contract = fundsContract(trn.creator, trn.prize_pot.symbol);
+
+   // extensions are serialized in order, so the ones before a stored extension can't stay absent
+   if (!trn.name_ref.has_value()) {
+      trn.name_ref = 0;
+   }
+
+   if (!trn.round.has_value()) {
+      trn.round = roundOf(trn);
+   }
+}
+
+uint8_t clashdometrn::toPotType(const string& type_prize_pot)
+{
+   if (type_prize_pot == "MINIMUM") {
+      return MINIMUM_POT;
+   } else if (type_prize_pot == "BONUS") {
+      return BONUS_POT;
+   }
+
+   return NO_POT;
+}
+
+std::optional <clashdometrn::nft_requirement> clashdometrn::toNftRequirement(const string& requeriment_nft)
+{
+   if (requeriment_nft.empty()) {
+      return std::nullopt;
+   }
+
+   nft_requirement requirement;
+   const char* error = parseNftRequirement(requeriment_nft, requirement);
+
+   check(error == nullptr, error);
+
+   return requirement;
+}
+
+const char* clashdometrn::parseNftRequirement(std::string_view requeriment_nft, nft_requirement& requirement)
+{
+   requirement = {eosio::name(), eosio::name(), -1, 1};
+
+   std::string_view remaining = requeriment_nft;
+   bool more = true;
+
+   // a trailing separator leaves an empty last field
+   for (uint8_t field = 0; more; field++) {
+
+      size_t separator = remaining.find(':');
+      std::string_view value = remaining.substr(0, separator);
+      more = separator != std::string_view::npos;
+      remaining = more ? remaining.substr(separator + 1) : std::string_view();
+
+      if (field >= 4 || value.empty()) {
+         return "Invalid requeriment NFT, the format is collection[:schema[:template_id[:count]]].";
+      }
+
+      // any schema or template
+      if ((field == 1 || field == 2) && value == "*") {
+         continue;
+      }
 
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == quantity.symbol; 
-      });
-      if (fund_itr != cr.funds.end()) {
-         *fund_itr += quantity;
+      if (field < 2) {
+         if (!isName(value)) {
+            return "Invalid requeriment NFT collection or schema.";
+         }
+         (field == 0 ? requirement.collection : requirement.schema) = eosio::name(value);
+         continue;
+      }
+
+      uint64_t number;
+
+      if (field == 2) {
+         if (!parseNumber(value, INT32_MAX, number)) {
+            return "Invalid requeriment NFT template.";
+         }
+         requirement.template_id = number;
       } else {
-         cr.funds.emplace_back(quantity);
+         if (!parseNumber(value, UINT8_MAX, number) || number == 0) {
+            return "Invalid requeriment NFT count.";
+         }
+         requirement.count = number;
+      }
+   }
+
+   return nullptr;
+}
+
+bool clashdometrn::isName(std::string_view value)
+{
+   if (value.size() > 12) {
+      return false;
+   }
+
+   for (char c : value) {
+      if (!(c >= 'a' && c <= 'z') && !(c >= '1' && c <= '5') && c != '.') {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void clashdometrn::addModerationRecords(name creator, uint64_t tournament_id, const vector <name>& accounts, const string& type)
+{
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
+   check(trn_itr->creator == creator, "The specified account isn't the creator of the tournament.");
+
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   modlog_t modlog = modlog_t(get_self(), tournament_id);
+
+   // sequences are never reused, even once the records holding the highest ones have expired. 
+   // Logs started before the counter existed continue after their last record
+   auto seq_itr = modseqs.find(tournament_id);
+   INSTRUMENT_OP("modseqs", finds);
+
+   uint64_t sequence = seq_itr != modseqs.end() ? seq_itr->next : modlog.available_primary_key();
+
+   // expire at least as many records as are added so the scope stays within the retention window
+   pruneModerationRecords(modlog, current_timestamp, accounts.size());
+
+   for (const name& account : accounts) {
+      auto log_itr = modlog.emplace(CONTRACTN, [&](auto& log) {
+         log.sequence = sequence++;
+         log.account = account;
+         log.timestamp = current_timestamp;
+         log.type = type;
+      });
+      INSTRUMENT_WRITE("modlog", emplaces, *log_itr);
+   }
+
+   if (seq_itr == modseqs.end()) {
+      seq_itr = modseqs.emplace(CONTRACTN, [&](auto& seq) {
+         seq.tournament_id = tournament_id;
+         seq.next = sequence;
+      });
+      INSTRUMENT_WRITE("modseqs", emplaces, *seq_itr);
+   } else {
+      modseqs.modify(seq_itr, CONTRACTN, [&](auto& seq) {
+         seq.next = sequence;
+      });
+      INSTRUMENT_WRITE("modseqs", modifies, *seq_itr);
+   }
+}
+
+void clashdometrn::pruneModerationRecords(modlog_t& modlog, uint64_t current_timestamp, uint64_t max_rows)
+{
+   auto log_itr = modlog.begin();
+
+   for (uint64_t erased = 0; erased < max_rows && log_itr != modlog.end() && log_itr->timestamp + MODLOG_RETENTION < current_timestamp; erased++) {
+      log_itr = modlog.erase(log_itr);
+      INSTRUMENT_OP("modlog", erases);
+   }
+}
+
+template <typename Index, typename InRange, typename Matches, typename Position>
+clashdometrn::trn_page clashdometrn::fillPage(const Index& trn_idx, typename Index::const_iterator trn_itr, uint64_t limit, uint64_t current_timestamp, InRange in_range, Matches matches, Position position)
+{
+   limit = limit == 0 || limit > MAX_PAGE_SIZE ? MAX_PAGE_SIZE : limit;
+
+   trn_page page = {{}, 0};
+
+   INSTRUMENT_OP("tournaments2", finds);
+
+   for (uint64_t visited = 0; trn_itr != trn_idx.end() && in_range(*trn_itr); trn_itr++, visited++) {
+
+      INSTRUMENT_OP("tournaments2", steps);
+
+      if (page.tournaments.size() == limit || visited == MAX_QUERY_ROWS) {
+         page.next_cursor = position(*trn_itr);
+         break;
+      }
+
+      if (matches(*trn_itr)) {
+         page.tournaments.push_back(toSummary(*trn_itr, current_timestamp));
+      }
+   }
+
+   return page;
+}
+
+template <typename Visit>
+void clashdometrn::scanStarted(name scan, uint64_t max_rows, uint64_t current_timestamp, Visit visit)
+{
+   auto scan_itr = scans.find(scan.value);
+   INSTRUMENT_OP("scans", finds);
+
+   // scopes before the saved one were done by earlier calls of this pass
+   bool resuming = scan_itr != scans.end();
+   uint64_t visited = 0;
+
+   for (uint64_t scope : tournamentScopes()) {
+
+      if (resuming && scope != scan_itr->scope) {
+         continue;
+      }
+
+      tournaments_t& trn_table = tournamentsIn(scope);
+
+      // oldest first, rows starting after now can't be finished so the scope ends there
+      auto trn_idx = trn_table.get_index<name("bystarttime")>();
+      auto trn_itr = trn_idx.lower_bound(resuming ? startKey(scan_itr->timestamp_start, scan_itr->tournament_id) : 0);
+      INSTRUMENT_OP("tournaments2", finds);
+
+      resuming = false;
+
+      for (; trn_itr != trn_idx.end() && trn_itr->timestamp_start <= current_timestamp; visited++) {
+
+         // out of rows, the next call starts from this one
+         if (visited == max_rows) {
+            auto save = [&](auto& row) {
+               row.scan = scan;
+               row.scope = scope;
+               row.timestamp_start = trn_itr->timestamp_start;
+               row.tournament_id = trn_itr->tournament_id;
+            };
+
+            if (scan_itr == scans.end()) {
+               scan_itr = scans.emplace(CONTRACTN, save);
+               INSTRUMENT_WRITE("scans", emplaces, *scan_itr);
+            } else {
+               scans.modify(scan_itr, CONTRACTN, save);
+               INSTRUMENT_WRITE("scans", modifies, *scan_itr);
+            }
+
+            return;
+         }
+
+         INSTRUMENT_OP("tournaments2", steps);
+
+         trn_itr = visit(trn_table, trn_idx, trn_itr);
+      }
+   }
+
+   // the pass is complete, the next call starts a new one from the oldest rows
+   if (scan_itr != scans.end()) {
+      scans.erase(scan_itr);
+      INSTRUMENT_OP("scans", erases);
+   }
+}
+
+template <typename Fill>
+clashdometrn::trn_page clashdometrn::fillScopesPage(uint128_t cursor, uint64_t limit, Fill fill)
+{
+   limit = limit == 0 || limit > MAX_PAGE_SIZE ? MAX_PAGE_SIZE : limit;
+
+   trn_page page = {{}, 0};
+
+   vector <uint64_t> scopes = tournamentScopes();
+
+   // the walk starts at the position of the cursor in its scope, later scopes from the start of their range
+   uint128_t resume = cursor & CURSOR_POSITION;
+
+   for (uint64_t number = cursor >> 96; number < scopes.size(); number++, resume = 0) {
+
+      tournaments_t& trn_table = tournamentsIn(scopes[number]);
+
+      // once the page is full the next scopes only tell whether there is a next page, which starts at their range
+      if (page.tournaments.size() == limit) {
+         trn_page next = fill(trn_table, 0, 1);
+
+         if (!next.tournaments.empty() || next.next_cursor != 0) {
+            page.next_cursor = (uint128_t) number << 96;
+            break;
+         }
+
+         continue;
+      }
+
+      trn_page part = fill(trn_table, resume, limit - page.tournaments.size());
+
+      page.tournaments.insert(page.tournaments.end(), part.tournaments.begin(), part.tournaments.end());
+
+      if (part.next_cursor != 0) {
+         page.next_cursor = ((uint128_t) number << 96) | part.next_cursor;
+         break;
+      }
+   }
+
+   return page;
+}
+
+uint8_t clashdometrn::phaseOf(const tournaments_s& trn, uint64_t current_timestamp)
+{
+   if (current_timestamp < trn.timestamp_start) {
+      return UPCOMING;
+   }
+
+   return current_timestamp <= trn.timestamp_end ? RUNNING : FINISHED;
+}
+
+clashdometrn::trn_summary clashdometrn::toSummary(const tournaments_s& trn, uint64_t current_timestamp)
+{
+   return trn_summary{
+      trn.tournament_id,
+      trn.creator,
+      stringOf(trn.name, trn.name_ref),
+      trn.game,
+      phaseOf(trn, current_timestamp),
+      trn.timestamp_start,
+      trn.timestamp_end,
+      currentPot(trn),
+      trn.type_prize_pot,
+      trn.requeriment_fee
+   };
+}
+
+clashdometrn::round_state clashdometrn::roundOf(const tournaments_s& trn)
+{
+   // fee and prize pot always share the same symbol
+   asset zero = asset(0, trn.prize_pot.symbol);
+
+   return trn.round.value_or(round_state{0, zero, trn.prize_pot, 0, ROUND_OPEN, 0, 0, zero});
+}
+
+void clashdometrn::releasePot(const tournaments_s& trn)
+{
+   round_state round = roundOf(trn);
+
+   // paid out rounds already returned what they didn't distribute
+   if (round.status == ROUND_PAID) {
+      return;
+   }
+
+   asset held = trn.prize_pot + round.collected - round.distributed;
+
+   if (held.amount > 0) {
+      addBalance(trn.creator, held, potContract(trn));
+   }
+}
+
+bool clashdometrn::isSettled(const tournaments_s& trn)
+{
+   round_state round = roundOf(trn);
+
+   // rounds without entries or scores have nothing to pay, their pot is still held
+   return round.status == ROUND_PAID || (round.status == ROUND_OPEN && round.entries == 0 && round.ranked == 0);
+}
+
+void clashdometrn::rankScore(leaderboard_t& leaderboard, round_state& round, name account, uint64_t score, uint64_t current_timestamp)
+{
+   auto brd_itr = leaderboard.find(account.value);
+   INSTRUMENT_OP("leaderboard", finds);
+
+   // the player is already ranked, its best score only goes up
+   if (brd_itr != leaderboard.end()) {
+      leaderboard.modify(brd_itr, CONTRACTN, [&](auto& brd) {
+         brd.timestamp = current_timestamp;
+         brd.score = score;
+      });
+      INSTRUMENT_WRITE("leaderboard", modifies, *brd_itr);
+
+      return;
+   }
+
+   // a full leaderboard drops its last row when the new score beats it
+   if (round.ranked >= LEADERBOARD_SIZE) {
+      auto rank_idx = leaderboard.get_index<name("byrank")>();
+      auto last_itr = --rank_idx.end();
+      INSTRUMENT_OP("leaderboard", finds);
+
+      if (score <= last_itr->score) {
+         return;
+      }
+
+      rank_idx.erase(last_itr);
+      INSTRUMENT_OP("leaderboard", erases);
+   } else {
+      round.ranked++;
+   }
+
+   brd_itr = leaderboard.emplace(CONTRACTN, [&](auto& brd) {
+      brd.account = account;
+      brd.timestamp = current_timestamp;
+      brd.score = score;
+   });
+   INSTRUMENT_WRITE("leaderboard", emplaces, *brd_itr);
+}
+
+asset clashdometrn::currentPot(const tournaments_s& trn)
+{
+   return roundOf(trn).pot;
+}
+
+void clashdometrn::joinTournament(name account, uint64_t tournament_id, const extended_asset& payment)
+{
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = findJoinable(trn_table, tournament_id, current_timestamp);
+
+   const asset& quantity = payment.quantity;
+
+   check(trn_itr->requeriment_fee.has_value(), "The tournament has no entry fee.");
+   checkLazy(quantity == *trn_itr->requeriment_fee, [&]() { return "The entry fee is " + trn_itr->requeriment_fee->to_string() + "."; });
+   check(isTokenSupported(trn_itr->creator, payment.get_extended_symbol(), TOKEN_FEE), "Token not supported.");
+
+   name contract = potContract(*trn_itr);
+
+   checkLazy(payment.contract == contract, [&]() { return "The entry fee has to be paid in tokens of " + contract.to_string() + "."; });
+
+   // nfts have to be locked before paying the fee
+   if (trn_itr->requeriment_nft.has_value()) {
+      check(lockedNfts(*trn_itr, account, trn_itr->requeriment_nft->count) >= trn_itr->requeriment_nft->count, "Lock the required NFTs before paying the entry fee.");
+   }
+
+   addEntry(trn_table, trn_itr, account, quantity, current_timestamp);
+
+   // fees are paid out with the prizes, so they go to clashdomepay like the creator funds
+   accrueDeposit(payment.contract, quantity, "Entry fee from " + account.to_string());
+}
+
+void clashdometrn::lockNfts(name account, uint64_t tournament_id, const vector <uint64_t>& asset_ids)
+{
+   uint64_t current_timestamp = eosio::current_time_point().sec_since_epoch();
+
+   tournaments_t& trn_table = tournamentsFor(tournament_id);
+
+   auto trn_itr = findJoinable(trn_table, tournament_id, current_timestamp);
+
+   check(trn_itr->requeriment_nft.has_value(), "The tournament has no NFT requirement.");
+
+   const nft_requirement& requirement = *trn_itr->requeriment_nft;
+
+   // the nfts are already owned by the contract when the notification arrives
+   atomic_assets_t assets = atomic_assets_t(name("atomicassets"), get_self().value);
+   nftlocks_t nftlocks = nftlocks_t(get_self(), tournament_id);
+
+   for (uint64_t asset_id : asset_ids) {
+
+      auto ast_itr = assets.require_find(asset_id, "Asset not found.");
+      INSTRUMENT_OP("assets", finds);
+
+      checkLazy(requirement.matches(ast_itr->collection_name, ast_itr->schema_name, ast_itr->template_id), [&]() { return "Asset " + to_string(asset_id) + " doesn't meet the NFT requirement."; });
+
+      auto lck_itr = nftlocks.emplace(CONTRACTN, [&](auto& lck) {
+         lck.asset_id = asset_id;
+         lck.account = account;
+         lck.round_start = trn_itr->timestamp_start;
+      });
+      INSTRUMENT_WRITE("nftlocks", emplaces, *lck_itr);
+   }
+
+   // tournaments with fee are entered when the fee is paid
+   if (trn_itr->requeriment_fee.has_value() || lockedNfts(*trn_itr, account, requirement.count) < requirement.count) {
+      return;
+   }
+
+   entries_t entries = entries_t(get_self(), tournament_id);
+
+   auto ent_itr = entries.find(account.value);
+   INSTRUMENT_OP("entries", finds);
+
+   if (ent_itr == entries.end() || ent_itr->round_start != trn_itr->timestamp_start) {
+      addEntry(trn_table, trn_itr, account, asset(0, trn_itr->prize_pot.symbol), current_timestamp);
+   }
+}
+
+clashdometrn::tournaments_t::const_iterator clashdometrn::findJoinable(tournaments_t& trn_table, uint64_t tournament_id, uint64_t current_timestamp)
+{
+   auto trn_itr = trn_table.require_find(tournament_id, "No tournament with this id exists");
+   INSTRUMENT_OP("tournaments2", finds);
+
+   // a finished recurring tournament is rolled forward by its first late entry
+   if (trn_itr->timestamp_end < current_timestamp && trn_itr->recreate && isSettled(*trn_itr)) {
+      rollTournament(trn_table, *trn_itr, current_timestamp);
+   }
+
+   check(current_timestamp <= trn_itr->timestamp_end, "The tournament has already finished.");
+
+   return trn_itr;
+}
+
+void clashdometrn::addEntry(tournaments_t& trn_table, tournaments_t::const_iterator trn_itr, name account, const asset& quantity, uint64_t current_timestamp)
+{
+   entries_t entries = entries_t(get_self(), trn_itr->tournament_id);
+
+   auto ent_itr = entries.find(account.value);
+   INSTRUMENT_OP("entries", finds);
+
+   if (ent_itr == entries.end()) {
+      ent_itr = entries.emplace(CONTRACTN, [&](auto& ent) {
+         ent.account = account;
+         ent.round_start = trn_itr->timestamp_start;
+         ent.timestamp = current_timestamp;
+         ent.fee = quantity;
+      });
+      INSTRUMENT_WRITE("entries", emplaces, *ent_itr);
+   } else {
+      check(ent_itr->round_start != trn_itr->timestamp_start, "Already joined this tournament.");
+
+      entries.modify(ent_itr, CONTRACTN, [&](auto& ent) {
+         ent.round_start = trn_itr->timestamp_start;
+         ent.timestamp = current_timestamp;
+         ent.fee = quantity;
+      });
+      INSTRUMENT_WRITE("entries", modifies, *ent_itr);
+   }
+
+   // the pot is updated with each entry so it never has to be recomputed from the entries
+   trn_table.modify(trn_itr, CONTRACTN, [&](auto& trn) {
+      round_state round = roundOf(trn);
+
+      round.entries++;
+      round.collected += quantity;
+      round.pot = trn.type_prize_pot == BONUS_POT ? trn.prize_pot + round.collected : std::max(trn.prize_pot, round.collected);
+
+      trn.round = round;
+   });
+   INSTRUMENT_WRITE("tournaments2", modifies, *trn_itr);
+}
+
+uint64_t clashdometrn::lockedNfts(const tournaments_s& trn, name account, uint64_t limit)
+{
+   nftlocks_t nftlocks = nftlocks_t(get_self(), trn.tournament_id);
+   auto lck_idx = nftlocks.get_index<name("byaccround")>();
+
+   uint128_t key = ((uint128_t) account.value << 64) | trn.timestamp_start;
+   uint64_t locked = 0;
+
+   auto lck_itr = lck_idx.lower_bound(key);
+   INSTRUMENT_OP("nftlocks", finds);
+
+   for (; locked < limit && lck_itr != lck_idx.end() && lck_itr->by_account_round() == key; lck_itr++) {
+      INSTRUMENT_OP("nftlocks", steps);
+      locked++;
+   }
+
+   return locked;
+}
+
+checksum256 clashdometrn::resultsLeaf(uint64_t tournament_id, uint32_t round_start, uint32_t index, name account, const asset& amount)
+{
+   char data[40];
+   size_t offset = 0;
+
+   auto put = [&](uint64_t value, size_t size) {
+      for (size_t i = 0; i < size; i++, offset++) {
+         data[offset] = (char) (value >> (8 * i));
+      }
+   };
+
+   put(tournament_id, 8);
+   put(round_start, 4);
+   put(index, 4);
+   put(account.value, 8);
+   put(amount.amount, 8);
+   put(amount.symbol.raw(), 8);
+
+   return eosio::sha256(data, sizeof(data));
+}
+
+checksum256 clashdometrn::resultsParent(const checksum256& left, const checksum256& right)
+{
+   std::array <uint8_t, 64> data;
+
+   auto left_bytes = left.extract_as_byte_array();
+   auto right_bytes = right.extract_as_byte_array();
+
+   std::copy(left_bytes.begin(), left_bytes.end(), data.begin());
+   std::copy(right_bytes.begin(), right_bytes.end(), data.begin() + 32);
+
+   return eosio::sha256((const char*) data.data(), data.size());
+}
+
+uint8_t clashdometrn::toMemoCommand(std::string_view memo, std::string_view& argument)
+{
+   size_t separator = memo.find(':');
+
+   if (separator == std::string_view::npos) {
+      argument = std::string_view();
+
+      if (memo == "add-funds") {
+         return MEMO_ADD_FUNDS;
+      } else if (memo == "add-tokens") {
+         return MEMO_ADD_TOKENS;
+      }
+
+      return MEMO_UNKNOWN;
+   }
+
+   std::string_view command = memo.substr(0, separator);
+   argument = memo.substr(separator + 1);
+
+   if (command == "join") {
+      return MEMO_JOIN;
+   }
+
+   return MEMO_UNKNOWN;
+}
+
+uint64_t clashdometrn::toNumber(std::string_view value, uint64_t max, const char* message)
+{
+   uint64_t number;
+
+   check(parseNumber(value, max, number), message);
+
+   return number;
+}
+
+bool clashdometrn::parseNumber(std::string_view value, uint64_t max, uint64_t& number)
+{
+   number = 0;
+
+   if (value.empty()) {
+      return false;
+   }
+
+   for (char c : value) {
+      if (c < '0' || c > '9' || number > (max - (c - '0')) / 10) {
+         return false;
+      }
+      number = number * 10 + (c - '0');
+   }
+
+   return true;
+}
+
+void clashdometrn::checkFeeAndStake(name creator, asset requeriment_fee, asset requeriment_stake)
+{
+   check(isTokenSupported(creator, extended_symbol(requeriment_fee.symbol, name()), TOKEN_FEE), "The specified fee symbol is not supported");
+   check(isTokenSupported(creator, extended_symbol(requeriment_stake.symbol, name()), TOKEN_STAKE), "The specified stake symbol is not supported");
+}
+
+void clashdometrn::accrueDeposit(name contract, const asset& quantity, const string& memo)
+{
+   sweeps_t sweeps = sweeps_t(get_self(), contract.value);
+
+   auto swp_itr = findSweep(sweeps, extended_symbol(quantity.symbol, contract));
+
+   sweeps.modify(swp_itr, CONTRACTN, [&](auto& swp) {
+      swp.pending += quantity;
+      swp.deposited += quantity;
+
+      if (swp.pending >= swp.threshold) {
+         sweepPending(swp, swp.pending, memo);
       }
    });
+   INSTRUMENT_WRITE("sweeps", modifies, *swp_itr);
+}
+
+clashdometrn::sweeps_t::const_iterator clashdometrn::findSweep(sweeps_t& sweeps, const extended_symbol& token)
+{
+   // the same symbol can be accepted from several contracts, each one has its own row
+   auto swp_itr = sweeps.find(token.get_symbol().raw());
+   INSTRUMENT_OP("sweeps", finds);
+
+   if (swp_itr == sweeps.end()) {
+      asset zero = asset(0, token.get_symbol());
+
+      swp_itr = sweeps.emplace(CONTRACTN, [&](auto& swp) {
+         swp.token = token;
+         swp.pending = zero;
+         swp.swept = zero;
+         swp.deposited = zero;
+         swp.threshold = zero;
+         swp.paid = zero;
+      });
+      INSTRUMENT_WRITE("sweeps", emplaces, *swp_itr);
+   }
+
+   return swp_itr;
+}
+
+void clashdometrn::sweepPending(sweeps_s& swp, asset quantity, const string& memo)
+{
+   swp.pending -= quantity;
+   swp.swept += quantity;
 
-   // TODO: send to clashdomepay
    action(
       permission_level{get_self(), name("active")},
-      contract,
+      swp.token.get_contract(),
       name("transfer"),
       std::make_tuple(
          get_self(),
          name("clashdomepay"),
          quantity,
-         "Add funds from " + get_self().to_string()
+         memo
       )
    ).send();
+   INSTRUMENT_INLINE();
 }
 
-// LOG ACTIONS
+void clashdometrn::payOut(const extended_asset& quantity, name to, const string& memo)
+{
+   sweeps_t sweeps = sweeps_t(get_self(), quantity.contract.value);
 
-ACTION clashdometrn::logcreatetrn(
-   uint64_t tournament_id, 
-   name creator,
-   string name,
-   uint64_t game,
-   uint64_t timestamp_start, 
-   uint64_t timestamp_end,
-   asset requeriment_fee,
-   asset requeriment_stake,
-   string requeriment_nft,
-   asset prize_pot,
-   string type_prize_pot,
-   bool recreate
-) {
-   
-   require_auth(get_self());
+   auto swp_itr = findSweep(sweeps, quantity.get_extended_symbol());
+
+   sweeps.modify(swp_itr, CONTRACTN, [&](auto& swp) {
+      // the transfer to clashdomepay runs before its payment
+      if (swp.pending.amount > 0) {
+         sweepPending(swp, swp.pending, "Sweep from " + get_self().to_string());
+      }
+
+      check(swp.swept - swp.paid >= quantity.quantity, "Not enough swept funds to pay out.");
+
+      swp.paid += quantity.quantity;
+   });
+   INSTRUMENT_WRITE("sweeps", modifies, *swp_itr);
+
+   action(
+      permission_level{name("clashdomepay"), name("active")},
+      quantity.contract,
+      name("transfer"),
+      std::make_tuple(
+         name("clashdomepay"),
+         to,
+         quantity.quantity,
+         memo
+      )
+   ).send();
+   INSTRUMENT_INLINE();
 }
 
-// NOTIFY
-void clashdometrn::receive_nft(
-   name from,
-   name to,
-   vector <uint64_t> asset_ids,
-   string memo
-) {
-   return;
+void clashdometrn::addBalance(name creator, const asset& quantity, name contract)
+{
+   check(tryAddBalance(creator, quantity, contract), "The funds of this symbol are held in tokens of another contract.");
 }
 
-void clashdometrn::receive_transfer(
-   name from,
-   name to,
-   asset quantity,
-   string memo
-) {
+bool clashdometrn::tryAddBalance(name creator, const asset& quantity, name contract)
+{
+   balances_s& bal = editBalance(creator, quantity.symbol);
+
+   // rows from before the contract was recorded take the one of their first credit
+   if (contract != name()) {
+      if (bal.contract.value_or(name()) == name()) {
+         bal.contract = contract;
+      } else if (bal.contract.value() != contract) {
+         return false;
+      }
+   }
 
-   if (to != get_self() || memo == "add-tokens") {
-      return;
+   bal.funds += quantity;
+   return true;
+}
+
+void clashdometrn::subBalance(name creator, const asset& quantity)
+{
+   check(trySubBalance(creator, quantity), "Insufficient funds.");
+}
+
+bool clashdometrn::trySubBalance(name creator, const asset& quantity)
+{
+   if (quantity.amount == 0) {
+      return true;
    }
 
-   name contract = get_first_receiver();
+   balances_s& bal = editBalance(creator, quantity.symbol);
+
+   if (bal.funds.symbol != quantity.symbol || bal.funds.amount < quantity.amount) {
+      return false;
+   }
+
+   bal.funds -= quantity;
+   return true;
+}
 
-   check(memo == "add-funds", "Memo has to be 'add-funds'.");
+name clashdometrn::tokenContract(name creator, const symbol& sym)
+{
+   name contract = findTokenContract(creator, sym);
 
-   auto cr_itr = creators.find(from.value);
+   check(contract != name(), "Token not supported.");
 
-   check(cr_itr != creators.end(), "Invalid creator " + from.to_string());
+   return contract;
+}
 
-   config_s current_config = config.get();
+name clashdometrn::findTokenContract(name creator, const symbol& sym)
+{
+   tokens_t global_tokens = tokens_t(get_self(), get_self().value);
+   auto tkn_itr = global_tokens.find(sym.raw());
+   INSTRUMENT_OP("tokens", finds);
 
-   bool is_fee_supported = false;
-   
-   for (extended_symbol supported_token_fee : current_config.supported_tokens_fee) {
-      if (supported_token_fee.get_symbol() == quantity.symbol && supported_token_fee.get_contract() == contract) {
-         is_fee_supported = true;
-         break;
-      }
+   if (tkn_itr != global_tokens.end() && (tkn_itr->type & TOKEN_FEE) != 0) {
+      return tkn_itr->token.get_contract();
    }
 
-   for (extended_symbol supported_token_fee : cr_itr->supported_tokens_fee) {
-      if (supported_token_fee.get_symbol() == quantity.symbol && supported_token_fee.get_contract() == contract) {
-         is_fee_supported = true;
-         break;
-      }
+   tokens_t creator_tokens = tokens_t(get_self(), creator.value);
+   tkn_itr = creator_tokens.find(sym.raw());
+   INSTRUMENT_OP("tokens", finds);
+
+   return tkn_itr != creator_tokens.end() && (tkn_itr->type & TOKEN_FEE) != 0 ? tkn_itr->token.get_contract() : name();
+}
+
+name clashdometrn::fundsContract(name creator, const symbol& sym)
+{
+   // the symbol alone can't tell a creator token from a global one, the deposit that funded the balance can
+   name contract = editBalance(creator, sym).contract.value_or(name());
+
+   return contract != name() ? contract : findTokenContract(creator, sym);
+}
+
+name clashdometrn::potContract(const tournaments_s& trn)
+{
+   name contract = trn.pot_contract.value_or(name());
+
+   return contract != name() ? contract : fundsContract(trn.creator, trn.prize_pot.symbol);
+}
+
+bool clashdometrn::isTokenSupported(name creator, const extended_symbol& token, uint8_t type)
+{
+   // global tokens live in the contract scope, creator tokens in the creator scope
+   tokens_t global_tokens = tokens_t(get_self(), get_self().value);
+   auto tkn_itr = global_tokens.find(token.get_symbol().raw());
+   INSTRUMENT_OP("tokens", finds);
+
+   if (tkn_itr != global_tokens.end() && tkn_itr->matches(token, type)) {
+      return true;
+   }
+
+   if (creator == get_self()) {
+      return false;
    }
 
-   check (is_fee_supported, "Token not supported.");
+   tokens_t creator_tokens = tokens_t(get_self(), creator.value);
+   tkn_itr = creator_tokens.find(token.get_symbol().raw());
+   INSTRUMENT_OP("tokens", finds);
 
-   creators.modify(cr_itr, CONTRACTN, [&](auto& cr) {
-      auto fund_itr = find_if(cr.funds.begin(), cr.funds.end(),[&](const asset& a) { 
-         return a.symbol == quantity.symbol; 
+   return tkn_itr != creator_tokens.end() && tkn_itr->matches(token, type);
+}
+
+bool clashdometrn::addToken(name scope, const extended_symbol& token, uint8_t type)
+{
+   tokens_t scope_tokens = tokens_t(get_self(), scope.value);
+   auto tkn_itr = scope_tokens.find(token.get_symbol().raw());
+   INSTRUMENT_OP("tokens", finds);
+
+   if (tkn_itr == scope_tokens.end()) {
+      tkn_itr = scope_tokens.emplace(CONTRACTN, [&](auto& tkn) {
+         tkn.token = token;
+         tkn.type = type;
       });
-      if (fund_itr != cr.funds.end()) {
-         *fund_itr += quantity;
-      } else {
-         cr.funds.emplace_back(quantity);
-      }
+      INSTRUMENT_WRITE("tokens", emplaces, *tkn_itr);
+      return true;
+   }
+
+   // a symbol can only be registered once per scope, whatever its type
+   if (tkn_itr->token.get_contract() != token.get_contract() || (tkn_itr->type & type) != 0) {
+      return false;
+   }
+
+   scope_tokens.modify(tkn_itr, CONTRACTN, [&](auto& tkn) {
+      tkn.type |= type;
    });
+   INSTRUMENT_WRITE("tokens", modifies, *tkn_itr);
+   return true;
+}
 
-   // TODO: send to clashdomepay
-   action(
-      permission_level{get_self(), name("active")},
-      contract,
-      name("transfer"),
-      std::make_tuple(
-         get_self(),
-         name("clashdomepay"),
-         quantity,
-         "Add funds from " + from.to_string()
-      )
-   ).send();
+void clashdometrn::migrateToken(name scope, const extended_symbol& token, uint8_t type, vector <skipped_token>& skipped)
+{
+   if (addToken(scope, token, type)) {
+      return;
+   }
+
+   tokens_t scope_tokens = tokens_t(get_self(), scope.value);
+   auto tkn_itr = scope_tokens.find(token.get_symbol().raw());
+   INSTRUMENT_OP("tokens", finds);
+
+   if (tkn_itr->token.get_contract() != token.get_contract()) {
+      skipped.push_back(skipped_token{scope, token, type});
+   }
+}
+
+// ROW CACHE
+const clashdometrn::config_s& clashdometrn::getConfig()
+{
+   if (!cached_config) {
+      cached_config = config.get();
+      INSTRUMENT_OP("config", finds);
+   }
 
+   return *cached_config;
 }
 
-// AUXILIAR FUNCTIONS
-void clashdometrn::checkPendingTournament(name creator, uint64_t timestamp_start, uint64_t timestamp_end, uint64_t game)
+clashdometrn::config_s& clashdometrn::editConfig()
 {
+   getConfig();
+   config_dirty = true;
 
-   auto trn_idx = tournaments.get_index<name("bycreator")>();
-   auto trn_itr = trn_idx.lower_bound(creator.value);
+   return *cached_config;
+}
 
-   while (trn_itr != trn_idx.end() && trn_itr->creator == creator) {
-      check(trn_itr->timestamp_end < timestamp_start || trn_itr->timestamp_start > timestamp_end || trn_itr->game != game, "Two tournaments at same time are not allowed.");
-      trn_itr++;
+clashdometrn::cached_creator* clashdometrn::loadCreator(name creator)
+{
+   auto cache_itr = cached_creators.find(creator.value);
+
+   if (cache_itr == cached_creators.end()) {
+      auto cr_itr = creators.find(creator.value);
+      INSTRUMENT_OP("creators", finds);
+
+      if (cr_itr == creators.end()) {
+         return nullptr;
+      }
+
+      cache_itr = cached_creators.emplace(creator.value, cached_creator{*cr_itr, ROW_CLEAN}).first;
    }
+
+   return &cache_itr->second;
 }
 
+const clashdometrn::creators_s* clashdometrn::findCreator(name creator)
+{
+   cached_creator* cached = loadCreator(creator);
 
-void clashdometrn::checkFeeAndStake(name creator, asset requeriment_fee, asset requeriment_stake)
+   return cached == nullptr || cached->state == ROW_ERASED ? nullptr : &cached->row;
+}
+
+clashdometrn::creators_s& clashdometrn::editCreator(name creator)
 {
-   config_s current_config = config.get();
+   cached_creator* cached = loadCreator(creator);
 
-   bool is_fee_supported = false;
-   
-   for (extended_symbol supported_token_fee : current_config.supported_tokens_fee) {
-      if (supported_token_fee.get_symbol() == requeriment_fee.symbol) {
-         is_fee_supported = true;
-         break;
+   check(cached != nullptr && cached->state != ROW_ERASED, "Invalid creator username");
+
+   if (cached->state == ROW_CLEAN) {
+      cached->state = ROW_DIRTY;
+   }
+
+   return cached->row;
+}
+
+void clashdometrn::emplaceCreator(const creators_s& creator)
+{
+   cached_creator* cached = loadCreator(creator.creator);
+
+   if (cached == nullptr) {
+      cached_creators.emplace(creator.creator.value, cached_creator{creator, ROW_NEW});
+   } else {
+      check(cached->state == ROW_ERASED, "Creator already exists.");
+      cached->row = creator;
+      cached->state = ROW_DIRTY;
+   }
+}
+
+void clashdometrn::eraseCreator(name creator)
+{
+   cached_creator* cached = loadCreator(creator);
+
+   check(cached != nullptr && cached->state != ROW_ERASED, "Invalid creator username");
+
+   releaseString(cached->row.img_ref.value_or(0));
+
+   if (cached->state == ROW_NEW) {
+      cached_creators.erase(creator.value);
+   } else {
+      cached->state = ROW_ERASED;
+   }
+}
+
+clashdometrn::tournaments_t& clashdometrn::tournamentsOf(uint64_t game)
+{
+#ifdef CLASHDOME_GAME_SCOPES
+   // games outside the registry stay in the contract scope
+   if (findGame(game) != nullptr) {
+      return tournamentsIn(game);
+   }
+#endif
+
+   return tournaments;
+}
+
+clashdometrn::tournaments_t& clashdometrn::tournamentsFor(uint64_t tournament_id)
+{
+#ifdef CLASHDOME_GAME_SCOPES
+   auto dir_itr = trngames.find(tournament_id);
+   INSTRUMENT_OP("trngames", finds);
+
+   if (dir_itr != trngames.end()) {
+      return tournamentsOf(dir_itr->game);
+   }
+#endif
+
+   return tournaments;
+}
+
+clashdometrn::tournaments_t& clashdometrn::tournamentsIn(uint64_t scope)
+{
+#ifdef CLASHDOME_GAME_SCOPES
+   if (scope != get_self().value) {
+      return tournaments_tables.try_emplace(scope, get_self(), scope).first->second;
+   }
+#endif
+
+   return tournaments;
+}
+
+vector <uint64_t> clashdometrn::tournamentScopes()
+{
+   vector <uint64_t> scopes = {get_self().value};
+
+#ifdef CLASHDOME_GAME_SCOPES
+   for (const game_rules& rules : GAMES) {
+      scopes.push_back(rules.game);
+   }
+#endif
+
+   return scopes;
+}
+
+void clashdometrn::setTournamentGame(uint64_t tournament_id, uint8_t game)
+{
+#ifdef CLASHDOME_GAME_SCOPES
+   if (findGame(game) == nullptr) {
+      eraseTournamentGame(tournament_id);
+      return;
+   }
+
+   auto dir_itr = trngames.find(tournament_id);
+   INSTRUMENT_OP("trngames", finds);
+
+   if (dir_itr == trngames.end()) {
+      dir_itr = trngames.emplace(CONTRACTN, [&](auto& dir) {
+         dir.tournament_id = tournament_id;
+         dir.game = game;
+      });
+      INSTRUMENT_WRITE("trngames", emplaces, *dir_itr);
+   } else if (dir_itr->game != game) {
+      trngames.modify(dir_itr, CONTRACTN, [&](auto& dir) {
+         dir.game = game;
+      });
+      INSTRUMENT_WRITE("trngames", modifies, *dir_itr);
+   }
+#endif
+}
+
+void clashdometrn::eraseTournamentGame(uint64_t tournament_id)
+{
+#ifdef CLASHDOME_GAME_SCOPES
+   auto dir_itr = trngames.find(tournament_id);
+   INSTRUMENT_OP("trngames", finds);
+
+   if (dir_itr != trngames.end()) {
+      trngames.erase(dir_itr);
+      INSTRUMENT_OP("trngames", erases);
+   }
+#endif
+}
+
+bool clashdometrn::hasTournaments(name creator)
+{
+   for (uint64_t scope : tournamentScopes()) {
+      auto trn_idx = tournamentsIn(scope).get_index<name("bycreator")>();
+      auto trn_itr = trn_idx.lower_bound(creatorKey(creator, 0));
+      INSTRUMENT_OP("tournaments2", finds);
+
+      if (trn_itr != trn_idx.end() && trn_itr->creator == creator) {
+         return true;
       }
    }
 
-   bool is_stake_supported = false;
-   
-   for (extended_symbol supported_token_stake : current_config.supported_tokens_stake) {
-      if (supported_token_stake.get_symbol() == requeriment_stake.symbol) {
-         is_stake_supported = true;
-         break;
+   return false;
+}
+
+uint64_t clashdometrn::internString(const string& value)
+{
+   // short values take less room inline than a handle
+   if (value.size() <= sizeof(uint64_t)) {
+      return 0;
+   }
+
+   std::array <uint8_t, 32> hash = eosio::sha256(value.data(), value.size()).extract_as_byte_array();
+
+   uint64_t handle = 0;
+
+   for (int i = 0; i < 8; i++) {
+      handle = handle << 8 | hash[i];
+   }
+
+   // probe forward past values sharing the hash, 0 is kept for inline values
+   while (true) {
+      handle = handle == 0 ? 1 : handle;
+
+      auto str_itr = strings.find(handle);
+      INSTRUMENT_OP("strings", finds);
+
+      if (str_itr == strings.end()) {
+         str_itr = strings.emplace(CONTRACTN, [&](auto& str) {
+            str.id = handle;
+            str.value = value;
+            str.refs = 1;
+         });
+         INSTRUMENT_WRITE("strings", emplaces, *str_itr);
+
+         return handle;
       }
+
+      if (str_itr->value == value) {
+         strings.modify(str_itr, CONTRACTN, [&](auto& str) {
+            str.refs++;
+         });
+         INSTRUMENT_WRITE("strings", modifies, *str_itr);
+
+         return handle;
+      }
+
+      handle++;
    }
+}
 
-   auto cr_itr = creators.find(creator.value);
+void clashdometrn::releaseString(uint64_t handle)
+{
+   if (handle == 0) {
+      return;
+   }
 
-   if (cr_itr != creators.end()) {
+   auto str_itr = strings.require_find(handle, "Interned string not found.");
+   INSTRUMENT_OP("strings", finds);
 
-      if (!is_fee_supported) {
-         for (extended_symbol supported_token_fee : cr_itr->supported_tokens_fee) {
-            if (supported_token_fee.get_symbol() == requeriment_fee.symbol) {
-               is_fee_supported = true;
-               break;
-            }
-         }
+   // erased values leave their id free, later probes for other values sharing the hash can stop there 
+   // and intern a value again next to its old copy, which only costs a duplicate row
+   if (str_itr->refs <= 1) {
+      strings.erase(str_itr);
+      INSTRUMENT_OP("strings", erases);
+      return;
+   }
+
+   strings.modify(str_itr, CONTRACTN, [&](auto& str) {
+      str.refs--;
+   });
+   INSTRUMENT_WRITE("strings", modifies, *str_itr);
+}
+
+string clashdometrn::stringOf(const string& value, const eosio::binary_extension <uint64_t>& handle)
+{
+   if (handle.value_or(0) == 0) {
+      return value;
+   }
+
+   auto str_itr = strings.require_find(handle.value(), "Interned string not found.");
+   INSTRUMENT_OP("strings", finds);
+
+   return str_itr->value;
+}
+
+void clashdometrn::setString(string& value, eosio::binary_extension <uint64_t>& handle, const string& new_value)
+{
+   uint64_t old_handle = handle.value_or(0);
+
+   if (stringOf(value, handle) == new_value) {
+      return;
+   }
+
+   uint64_t new_handle = internString(new_value);
+
+   releaseString(old_handle);
+
+   if (new_handle == 0) {
+      value = new_value;
+      handle.reset();
+   } else {
+      value = "";
+      handle = new_handle;
+   }
+}
+
+clashdometrn::balances_s& clashdometrn::editBalance(name creator, symbol sym)
+{
+   auto key = std::make_pair(creator.value, sym.code().raw());
+   auto cache_itr = cached_balances.find(key);
+
+   if (cache_itr == cached_balances.end()) {
+      balances_t& balances = balances_tables.try_emplace(creator.value, get_self(), creator.value).first->second;
+      auto bal_itr = balances.find(sym.code().raw());
+      INSTRUMENT_OP("balances", finds);
+
+      if (bal_itr == balances.end()) {
+         cache_itr = cached_balances.emplace(key, cached_balance{balances_s{asset(0, sym)}, ROW_NEW, 0}).first;
+      } else {
+         cache_itr = cached_balances.emplace(key, cached_balance{*bal_itr, ROW_CLEAN, bal_itr->funds.amount}).first;
       }
+   }
 
-      if (!is_stake_supported) {
-         for (extended_symbol supported_token_stake : cr_itr->supported_tokens_stake) {
-            if (supported_token_stake.get_symbol() == requeriment_stake.symbol) {
-               is_stake_supported = true;
-               break;
-            }
-         }
+   return cache_itr->second.row;
+}
+
+void clashdometrn::flushCache()
+{
+   if (config_dirty) {
+      config.set(*cached_config, get_self());
+      INSTRUMENT_WRITE("config", modifies, *cached_config);
+      config_dirty = false;
+   }
+
+   // the multi_index objects still hold the rows loaded above, so these finds don't reach the database
+   for (auto& [key, cached] : cached_creators) {
+      if (cached.state == ROW_NEW) {
+         creators.emplace(CONTRACTN, [&](auto& cr) {
+            cr = cached.row;
+         });
+         INSTRUMENT_WRITE("creators", emplaces, cached.row);
+      } else if (cached.state == ROW_DIRTY) {
+         creators.modify(creators.find(key), CONTRACTN, [&](auto& cr) {
+            cr = cached.row;
+         });
+         INSTRUMENT_WRITE("creators", modifies, cached.row);
+      } else if (cached.state == ROW_ERASED) {
+         creators.erase(creators.find(key));
+         INSTRUMENT_OP("creators", erases);
       }
    }
+   cached_creators.clear();
+
+   for (auto& [key, cached] : cached_balances) {
+      // untouched rows, failed debits and edits netting to zero leave the amount as loaded
+      if (cached.row.funds.amount == cached.loaded) {
+         continue;
+      }
+
+      balances_t& balances = balances_tables.at(key.first);
 
-   check(is_fee_supported, "The specified stake symbol is not supported");
-   check(is_stake_supported, "The specified stake symbol is not supported");
-}
\ No newline at end of file
+      if (cached.state == ROW_NEW) {
+         balances.emplace(CONTRACTN, [&](auto& bal) {
+            bal = cached.row;
+         });
+         INSTRUMENT_WRITE("balances", emplaces, cached.row);
+      } else {
+         balances.modify(balances.find(key.second), CONTRACTN, [&](auto& bal) {
+            bal = cached.row;
+         });
+         INSTRUMENT_WRITE("balances", modifies, cached.row);
+      }
+   }
+   cached_balances.clear();
+}
@@ -0,0 +1,375 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tester.hpp"
+
+// database work and wall time per action over tables filled with many tournaments and creators.
+// Usage: clashdometrn_bench [--rows N]... [--history N]... [--iterations N] [--checks N], rows default to 10000 
+// and 100000, history to 100, 1000 and 10000 and checks to 1000000
+using namespace clashdome_test;
+
+namespace {
+
+   const uint32_t HOUR = 3600;
+   const uint32_t DAY = 24 * HOUR;
+
+   // tournaments per creator, spread over every game
+   const uint64_t CREATOR_TOURNAMENTS = 10;
+
+   const name BENCH = name("bench");
+
+   name account(char prefix, uint64_t number)
+   {
+      std::string str(1, prefix);
+
+      for (int i = 0; i < 6; i++, number /= 26) {
+         str += char('a' + number % 26);
+      }
+
+      return name(str);
+   }
+
+   // scope the tournaments of a game are stored under
+   uint64_t scope_of(uint64_t game)
+   {
+#ifdef CLASHDOME_GAME_SCOPES
+      return game;
+#else
+      (void) game;
+      return SELF.value;
+#endif
+   }
+
+   // the tournaments table read through its first two indices, to measure the scans the contract did 
+   // before the bycrgameend and bygamestart indices
+   struct creator_key {
+
+      typedef uint128_t result_type;
+
+      uint128_t operator()(const tournament_row& trn) const { return ((uint128_t) trn.creator.value << 64) | trn.tournament_id; }
+   };
+
+   struct start_key {
+
+      typedef uint128_t result_type;
+
+      uint128_t operator()(const tournament_row& trn) const { return ((uint128_t) trn.timestamp_start << 64) | trn.tournament_id; }
+   };
+
+   typedef multi_index <name("tournaments2"), tournament_row, 
+      indexed_by <name("bycreator"), creator_key>,
+      indexed_by <name("bystarttime"), start_key>> tournament_table;
+
+   // the overlap check as it walked every tournament of the creator
+   bool scan_creator(name creator, uint64_t game, uint32_t start, uint32_t end)
+   {
+      tournament_table trn_table(SELF, scope_of(game));
+      auto trn_idx = trn_table.get_index <name("bycreator")>();
+
+      for (auto trn_itr = trn_idx.lower_bound((uint128_t) creator.value << 64); trn_itr != trn_idx.end() && trn_itr->creator == creator; trn_itr++) {
+         if (trn_itr->game == game && trn_itr->timestamp_start <= end && start <= trn_itr->timestamp_end) {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   // a page of the upcoming tournaments of game as found walking every game in start time order
+   uint64_t scan_start(uint64_t game, uint32_t from, uint64_t limit)
+   {
+      tournament_table trn_table(SELF, scope_of(game));
+      auto trn_idx = trn_table.get_index <name("bystarttime")>();
+      uint64_t found = 0;
+
+      for (auto trn_itr = trn_idx.lower_bound((uint128_t) from << 64); trn_itr != trn_idx.end() && found < limit; trn_itr++) {
+         if (trn_itr->game == game) {
+            found++;
+         }
+      }
+
+      return found;
+   }
+
+   clashdometrn::tournament_spec spec(uint64_t game, uint32_t start, const asset& fee, const asset& pot)
+   {
+      return clashdometrn::tournament_spec{"Cup", game, start, start + HOUR, fee, tlm(0), "", pot, "MINIMUM", false};
+   }
+
+   struct bench {
+
+      tester t;
+      std::vector <name> creators;
+      std::vector <uint64_t> first_ids;
+      uint64_t iterations;
+
+      // rows tournaments over rows / CREATOR_TOURNAMENTS creators. Each creator has a tournament of
+      // every game every 2 hours, and the creators start a minute apart
+      bench(uint64_t rows, uint64_t iterations) : iterations(iterations)
+      {
+         t.init();
+
+         uint64_t creator_count = rows == 0 ? 0 : std::max <uint64_t>(1, rows / CREATOR_TOURNAMENTS);
+
+         for (uint64_t number = 0; number < creator_count; number++) {
+            name creator = account('c', number);
+
+            t.add_creator(creator);
+            t.deposit(creator, tlm(100000000000));
+
+            uint64_t count = rows / creator_count + (number < rows % creator_count ? 1 : 0);
+
+            std::vector <clashdometrn::tournament_spec> specs;
+
+            for (uint64_t k = 0; k < count; k++) {
+               uint32_t start = START_TIME + HOUR + (number % 600) * 60 + (k / GAMES) * 2 * HOUR;
+               specs.push_back(spec(k % GAMES + 1, start, tlm(0), tlm(10000)));
+            }
+
+            creators.push_back(creator);
+            first_ids.push_back(t.next_id());
+
+            t.push({active(creator)}, [&](clashdometrn& c) { c.createtrns(creator, specs); });
+         }
+
+         t.add_creator(BENCH);
+         t.deposit(BENCH, tlm(100000000000));
+      }
+
+      static constexpr uint64_t GAMES = 6;
+
+      template <typename F>
+      void report(const char* action, const std::vector <permission_level>& auths, F&& f, name first_receiver = SELF)
+      {
+         host::counters total;
+         double micros = 0;
+
+         for (uint64_t i = 0; i < iterations; i++) {
+            auto [work, elapsed] = t.measure(auths, f, first_receiver);
+
+            total.finds += work.finds;
+            total.steps += work.steps;
+            total.reads += work.reads;
+            total.bytes_read += work.bytes_read;
+            total.writes += work.writes;
+            total.bytes_written += work.bytes_written;
+            total.erases += work.erases;
+            micros += elapsed;
+         }
+
+         double n = (double) iterations;
+
+         std::printf("%-28s %8.1f %8.1f %8.1f %10.0f %8.1f %10.0f %8.1f %10.2f\n", action,
+            total.finds / n, total.steps / n, total.reads / n, total.bytes_read / n,
+            total.writes / n, total.bytes_written / n, total.erases / n, micros / n);
+      }
+
+      static void header()
+      {
+         std::printf("%-28s %8s %8s %8s %10s %8s %10s %8s %10s\n", "action", "finds", "steps", "reads", "bytes read", "writes", "bytes wrt", "erases", "us/call");
+      }
+
+      void run()
+      {
+         name creator = creators.front();
+         uint64_t id = first_ids.front();
+
+         header();
+
+         report("createtrn", {active(creator)}, [&](clashdometrn& c) {
+            c.createtrn(creator, "Cup", 1, START_TIME + 300 * DAY, START_TIME + 300 * DAY + HOUR, tlm(0), tlm(0), "", tlm(10000), "MINIMUM", false);
+         });
+
+         report("edittrn", {active(creator)}, [&](clashdometrn& c) {
+            c.edittrn(id, creator, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR + 1800, tlm(0), tlm(0), "", tlm(20000), "MINIMUM", false);
+         });
+
+         report("canceltrn", {active(creator)}, [&](clashdometrn& c) { c.canceltrn(creator, id); });
+
+         report("transfer add-funds", {active(creator)}, [&](clashdometrn& c) { c.receive_transfer(creator, SELF, tlm(10000), "add-funds"); }, TOKEN_CONTRACT);
+
+         report("listupcoming game", {}, [&](clashdometrn& c) { c.listupcoming(1, 0, 50, 0); });
+         report("bystarttime scan game", {}, [&](clashdometrn&) { scan_start(1, t.now(), 50); });
+         report("listupcoming all", {}, [&](clashdometrn& c) { c.listupcoming(0, 0, 50, 0); });
+         report("listbycr", {}, [&](clashdometrn& c) { c.listbycr(creator, 0, 50, 0); });
+         report("getcreator", {}, [&](clashdometrn& c) { c.getcreator(creator); });
+
+         // a tournament to join and one with a leaderboard to pay out
+         uint64_t join_id = t.next_id();
+         uint64_t pay_id = join_id + 1;
+
+         t.push({active(BENCH)}, [&](clashdometrn& c) {
+            c.createtrns(BENCH, {spec(1, START_TIME + HOUR, tlm(10000), tlm(100000)), spec(2, START_TIME + HOUR, tlm(0), tlm(100000))});
+         });
+
+         t.set_time(START_TIME + HOUR + 1);
+
+         report("transfer join", {active(name("player"))}, [&](clashdometrn& c) {
+            c.receive_transfer(name("player"), SELF, tlm(10000), "join:" + std::to_string(join_id));
+         }, TOKEN_CONTRACT);
+
+         permission_level oracle = {SELF, name("oracle")};
+
+         for (uint64_t i = 0; i < 10; i++) {
+            t.push({oracle}, [&](clashdometrn& c) { c.submitscores(pay_id, {{account('p', i), 100 + i}}); });
+         }
+
+         report("submitscores", {oracle}, [&](clashdometrn& c) { c.submitscores(pay_id, {{account('p', 10), 50}}); });
+
+         t.set_time(START_TIME + 2 * HOUR + 1);
+
+         report("payout 10", {active(SELF)}, [&](clashdometrn& c) { c.payout(pay_id, 10); });
+
+         // the tournaments of the first day have finished
+         t.set_time(START_TIME + DAY);
+
+         report("prunetrn 100", {active(SELF)}, [&](clashdometrn& c) { c.prunetrn(100); });
+         report("rollover 100", {active(SELF)}, [&](clashdometrn& c) { c.rollover(100); });
+      }
+   };
+
+   // createtrn for a creator with count finished tournaments over every game, next to the bycreator scan
+   // the overlap check did, which visited all of them
+   void history(uint64_t count, uint64_t iterations)
+   {
+      bench b(0, iterations);
+      tester& t = b.t;
+
+      std::vector <clashdometrn::tournament_spec> specs;
+      uint32_t last_end = 0;
+
+      for (uint64_t k = 0; k < count; k++) {
+         uint32_t start = START_TIME + HOUR + (k / bench::GAMES) * 2 * HOUR;
+         specs.push_back(spec(k % bench::GAMES + 1, start, tlm(0), tlm(0)));
+         last_end = start + HOUR;
+
+         if (specs.size() == 100 || k + 1 == count) {
+            t.push({active(BENCH)}, [&](clashdometrn& c) { c.createtrns(BENCH, specs); });
+            specs.clear();
+         }
+      }
+
+      t.set_time(std::max <uint32_t>(last_end, START_TIME) + DAY);
+
+      uint32_t start = t.now() + HOUR;
+
+      std::printf("\n%llu finished tournaments of one creator, %llu iterations\n", (unsigned long long) count, (unsigned long long) iterations);
+      bench::header();
+
+      b.report("createtrn", {active(BENCH)}, [&](clashdometrn& c) {
+         c.createtrn(BENCH, "Cup", 1, start, start + HOUR, tlm(0), tlm(0), "", tlm(0), "MINIMUM", false);
+      });
+
+      b.report("bycreator scan", {}, [&](clashdometrn&) { scan_creator(BENCH, 1, start, start + HOUR); });
+   }
+
+   // passing checks with the messages of clashdometrn.cpp, formatted up front as they were before checkLazy 
+   // and only on failure as checkLazy does. checkLazy is private to the contract, so its body is repeated here
+   template <typename Message>
+   void check_lazy(bool condition, Message&& message)
+   {
+      if (!condition) {
+         check(false, message());
+      }
+   }
+
+   template <typename F>
+   void time_checks(const char* label, uint64_t count, F&& f)
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      for (uint64_t i = 0; i < count; i++) {
+         f(i);
+      }
+
+      double nanos = std::chrono::duration <double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+      std::printf("%-28s %10.2f\n", label, nanos / (double) count);
+   }
+
+   void checks(uint64_t count)
+   {
+      // MIN_DURATION and MAX_DURATION of the contract
+      const uint32_t min_duration = 1;
+      const uint32_t max_duration = 168;
+
+      // the condition and the names are read through volatiles, so neither the check nor the message folds away
+      volatile bool pass = true;
+      volatile uint64_t raw = name("creator").value;
+
+      std::printf("\n%llu passing checks\n%-28s %10s\n", (unsigned long long) count, "check", "ns/check");
+
+      time_checks("duration eager", count, [&](uint64_t) {
+         check(pass, "Duration must be between " + std::to_string(min_duration) + " and " + std::to_string(max_duration) + " hours.");
+      });
+      time_checks("duration lazy", count, [&](uint64_t) {
+         check_lazy(pass, [&]() { return "Duration must be between " + std::to_string(min_duration) + " and " + std::to_string(max_duration) + " hours."; });
+      });
+      time_checks("creator eager", count, [&](uint64_t i) {
+         check(pass, "Creator " + name(raw + i).to_string() + " doesn't exists.");
+      });
+      time_checks("creator lazy", count, [&](uint64_t i) {
+         check_lazy(pass, [&]() { return "Creator " + name(raw + i).to_string() + " doesn't exists."; });
+      });
+      time_checks("entry fee eager", count, [&](uint64_t i) {
+         check(pass, "The entry fee is " + tlm(int64_t(i)).to_string() + ".");
+      });
+      time_checks("entry fee lazy", count, [&](uint64_t i) {
+         check_lazy(pass, [&]() { return "The entry fee is " + tlm(int64_t(i)).to_string() + "."; });
+      });
+   }
+}
+
+int main(int argc, char** argv)
+{
+   std::vector <uint64_t> sizes;
+   std::vector <uint64_t> histories;
+   uint64_t iterations = 20;
+   uint64_t check_count = 1000000;
+
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (std::strcmp(argv[i], "--rows") == 0) {
+         sizes.push_back(std::strtoull(argv[i + 1], nullptr, 10));
+      } else if (std::strcmp(argv[i], "--history") == 0) {
+         histories.push_back(std::strtoull(argv[i + 1], nullptr, 10));
+      } else if (std::strcmp(argv[i], "--checks") == 0) {
+         check_count = std::max <uint64_t>(1, std::strtoull(argv[i + 1], nullptr, 10));
+      } else if (std::strcmp(argv[i], "--iterations") == 0) {
+         iterations = std::max <uint64_t>(1, std::strtoull(argv[i + 1], nullptr, 10));
+      }
+   }
+
+   if (sizes.empty()) {
+      sizes = {10000, 100000};
+   }
+
+   if (histories.empty()) {
+      histories = {100, 1000, 10000};
+   }
+
+   for (uint64_t rows : sizes) {
+#ifdef CLASHDOME_GAME_SCOPES
+      const char* layout = "per-game scopes";
+#else
+      const char* layout = "single scope";
+#endif
+
+      std::printf("\n%llu tournaments, %llu creators, %s, %llu iterations\n", (unsigned long long) rows,
+         (unsigned long long) std::max <uint64_t>(1, rows / CREATOR_TOURNAMENTS), layout, (unsigned long long) iterations);
+
+      bench b(rows, iterations);
+      b.run();
+   }
+
+   for (uint64_t count : histories) {
+      history(count, iterations);
+   }
+
+   checks(check_count);
+
+   return 0;
+}
@@ -0,0 +1,963 @@
+#include <cstdio>
+#include <functional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tester.hpp"
+
+using namespace clashdome_test;
+
+namespace {
+
+   int failures = 0;
+
+   void expect(bool condition, const char* text, int line)
+   {
+      if (!condition) {
+         std::printf("   line %d: %s\n", line, text);
+         failures++;
+      }
+   }
+
+#define EXPECT(...) expect((__VA_ARGS__), #__VA_ARGS__, __LINE__)
+
+   const name ALICE = name("alice");
+   const name BOB = name("bob");
+   const name CAROL = name("carol");
+   const name DAVE = name("dave");
+
+   const uint32_t HOUR = 3600;
+   const uint32_t DAY = 24 * HOUR;
+
+   // initialized contract with alice as a creator holding 1000 TLM
+   tester funded()
+   {
+      tester t;
+      t.init();
+      t.add_creator(ALICE);
+      t.deposit(ALICE, tlm(10000000));
+      return t;
+   }
+
+   std::vector <uint64_t> ids(const clashdometrn::trn_page& page)
+   {
+      std::vector <uint64_t> result;
+
+      for (const auto& trn : page.tournaments) {
+         result.push_back(trn.tournament_id);
+      }
+
+      return result;
+   }
+
+   // same leaf and parent hashes as the contract, the leaf record packed as little endian integers
+   checksum256 leaf(uint64_t tournament_id, uint32_t round_start, uint32_t index, name account, const asset& amount)
+   {
+      std::vector <char> data = pack(std::make_tuple(tournament_id, round_start, index, account.value, amount.amount, amount.symbol.raw()));
+      return sha256(data.data(), data.size());
+   }
+
+   checksum256 parent(const checksum256& left, const checksum256& right)
+   {
+      std::vector <char> data = pack(std::make_tuple(left, right));
+      return sha256(data.data(), data.size());
+   }
+
+   void create_and_cancel()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 3 * HOUR, tlm(0), tlm(100000));
+
+      EXPECT(t.tournament(id).has_value());
+      EXPECT(t.balance(ALICE) == 10000000 - 100000);
+
+      EXPECT(t.error({active(BOB)}, [&](clashdometrn& c) { c.canceltrn(BOB, id); }) == "The specified account isn't the creator of the tournament.");
+
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.canceltrn(ALICE, id); });
+
+      EXPECT(!t.tournament(id).has_value());
+      EXPECT(t.balance(ALICE) == 10000000);
+   }
+
+   void failed_action_rolls_back()
+   {
+      tester t = funded();
+
+      std::string error = t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.createtrn(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 3 * HOUR, tlm(0), tlm(0), "", tlm(20000000), "MINIMUM", false);
+      });
+
+      EXPECT(error == "Insufficient funds.");
+      EXPECT(t.balance(ALICE) == 10000000);
+      EXPECT(t.next_id() == 1);
+   }
+
+   void overlap_check()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + 2 * HOUR, START_TIME + 4 * HOUR, tlm(0), tlm(0));
+
+      auto create = [&](uint64_t game, uint32_t start, uint32_t end) {
+         return t.error({active(ALICE)}, [&](clashdometrn& c) {
+            c.createtrn(ALICE, "Cup", game, start, end, tlm(0), tlm(0), "", tlm(0), "MINIMUM", false);
+         });
+      };
+
+      const std::string overlap = "Two tournaments at same time are not allowed.";
+
+      EXPECT(create(1, START_TIME + HOUR, START_TIME + 2 * HOUR) == overlap);
+      EXPECT(create(1, START_TIME + 3 * HOUR, START_TIME + 5 * HOUR) == overlap);
+      EXPECT(create(1, START_TIME + HOUR, START_TIME + 5 * HOUR) == overlap);
+      EXPECT(create(2, START_TIME + 2 * HOUR, START_TIME + 4 * HOUR) == "");
+      EXPECT(create(1, START_TIME + 4 * HOUR + 1, START_TIME + 6 * HOUR) == "");
+
+      t.add_creator(BOB);
+      EXPECT(t.error({active(BOB)}, [&](clashdometrn& c) {
+         c.createtrn(BOB, "Cup", 1, START_TIME + 2 * HOUR, START_TIME + 4 * HOUR, tlm(0), tlm(0), "", tlm(0), "MINIMUM", false);
+      }) == "");
+
+      // an edited tournament doesn't collide with itself
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.edittrn(id, ALICE, "Cup", 1, START_TIME + 2 * HOUR, START_TIME + 3 * HOUR, tlm(0), tlm(0), "", tlm(0), "MINIMUM", false);
+      }) == "");
+
+      // batches are checked among themselves too
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.createtrns(ALICE, {
+            {"A", 3, START_TIME + HOUR, START_TIME + 3 * HOUR, tlm(0), tlm(0), "", tlm(0), "MINIMUM", false},
+            {"B", 3, START_TIME + 2 * HOUR, START_TIME + 4 * HOUR, tlm(0), tlm(0), "", tlm(0), "MINIMUM", false}
+         });
+      }) == overlap);
+   }
+
+   void listupcoming_pages()
+   {
+      tester t = funded();
+
+      std::vector <uint64_t> created;
+
+      for (uint32_t i = 0; i < 5; i++) {
+         created.push_back(t.create(ALICE, "Cup", 1, START_TIME + (2 * i + 1) * HOUR, START_TIME + (2 * i + 2) * HOUR, tlm(0), tlm(0)));
+      }
+
+      t.create(ALICE, "Other", 2, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+
+      auto list = [&](uint64_t game, uint64_t limit, uint128_t cursor) {
+         return t.push({}, [&](clashdometrn& c) { return c.listupcoming(game, 0, limit, cursor); });
+      };
+
+      clashdometrn::trn_page first = list(1, 2, 0);
+
+      EXPECT(ids(first) == std::vector <uint64_t>({created[0], created[1]}));
+      EXPECT(first.next_cursor != 0);
+
+      // the page resumes in place when rows before the cursor go away
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.canceltrn(ALICE, created[1]); });
+
+      clashdometrn::trn_page second = list(1, 2, first.next_cursor);
+
+      EXPECT(ids(second) == std::vector <uint64_t>({created[2], created[3]}));
+
+      clashdometrn::trn_page third = list(1, 2, second.next_cursor);
+
+      EXPECT(ids(third) == std::vector <uint64_t>({created[4]}));
+      EXPECT(third.next_cursor == 0);
+
+      EXPECT(list(0, 50, 0).tournaments.size() == 5);
+   }
+
+   void listbycr_pages()
+   {
+      tester t = funded();
+      t.add_creator(BOB);
+
+      std::vector <uint64_t> created;
+
+      for (uint32_t i = 0; i < 4; i++) {
+         created.push_back(t.create(ALICE, "Cup", 1 + i, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0)));
+         t.create(BOB, "Cup", 1 + i, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+      }
+
+      auto list = [&](uint8_t status, uint128_t cursor) {
+         return t.push({}, [&](clashdometrn& c) { return c.listbycr(ALICE, status, 3, cursor); });
+      };
+
+      clashdometrn::trn_page first = list(0, 0);
+      clashdometrn::trn_page second = list(0, first.next_cursor);
+
+      EXPECT(ids(first) == std::vector <uint64_t>({created[0], created[1], created[2]}));
+      EXPECT(ids(second) == std::vector <uint64_t>({created[3]}));
+      EXPECT(second.next_cursor == 0);
+
+      t.advance(HOUR + 1);
+
+      EXPECT(list(1, 0).tournaments.empty());
+      EXPECT(list(2, 0).tournaments.size() == 3);
+   }
+
+   void queries_are_read_only()
+   {
+      tester t = funded();
+
+      t.create(ALICE, "Weekend championship", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(10000));
+
+      size_t sent = t.sent().size();
+      host::counters before = host::state().work;
+
+      // read-only actions can neither write rows nor send actions, in the instrumented build too
+      t.push({}, [&](clashdometrn& c) { c.listupcoming(1, 0, 10, 0); });
+      t.push({}, [&](clashdometrn& c) { c.listupcoming(0, 0, 10, 0); });
+      t.push({}, [&](clashdometrn& c) { c.listbycr(ALICE, 0, 10, 0); });
+      t.push({}, [&](clashdometrn& c) { c.getcreator(ALICE); });
+
+      host::counters work = host::state().work - before;
+
+      EXPECT(work.writes == 0 && work.erases == 0);
+      EXPECT(t.sent().size() == sent);
+   }
+
+   void prunetrn_refunds_and_resumes()
+   {
+      tester t = funded();
+
+      uint64_t first = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(100000));
+      uint64_t second = t.create(ALICE, "Cup", 2, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(200000));
+      uint64_t later = t.create(ALICE, "Cup", 3, START_TIME + 5 * HOUR, START_TIME + 6 * HOUR, tlm(0), tlm(0));
+
+      EXPECT(t.balance(ALICE) == 10000000 - 300000);
+
+      t.advance(3 * HOUR);
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.prunetrn(1); });
+
+      EXPECT(!t.tournament(first).has_value());
+      EXPECT(t.tournament(second).has_value());
+      EXPECT(t.balance(ALICE) == 10000000 - 200000);
+      EXPECT(rows <name("scans"), scan_row>(SELF, SELF.value).size() == 1);
+
+      size_t sent = t.sent().size();
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.prunetrn(1); });
+
+      EXPECT(!t.tournament(second).has_value());
+      EXPECT(t.tournament(later).has_value());
+      EXPECT(t.balance(ALICE) == 10000000);
+      EXPECT(rows <name("scans"), scan_row>(SELF, SELF.value).empty());
+
+      EXPECT(t.last_sent(name("logprunetrn"), sent) != nullptr);
+   }
+
+   void rollover_keeps_the_pot()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(100000), true);
+
+      t.advance(3 * HOUR);
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.rollover(10); });
+
+      auto trn = t.tournament(id);
+
+      EXPECT(trn.has_value() && trn->timestamp_start == START_TIME + HOUR + DAY && trn->timestamp_end == START_TIME + 2 * HOUR + DAY);
+
+      // the round wasn't paid out, so its pot carries over instead of being debited again
+      EXPECT(t.balance(ALICE) == 10000000 - 100000);
+   }
+
+   void join_and_payout()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(10000), tlm(100000));
+
+      t.advance(HOUR);
+
+      t.transfer(BOB, tlm(10000), "join:" + std::to_string(id));
+      t.transfer(CAROL, tlm(10000), "join:" + std::to_string(id));
+
+      EXPECT(t.error({active(DAVE)}, [&](clashdometrn& c) { c.receive_transfer(DAVE, SELF, tlm(5000), "join:" + std::to_string(id)); }, TOKEN_CONTRACT) == "The entry fee is 1.0000 TLM.");
+
+      // fees are swept to clashdomepay like the creator funds
+      EXPECT(t.sweep().deposited == tlm(10000000 + 20000));
+      EXPECT(t.sweep().swept == tlm(10000000 + 20000));
+
+      permission_level oracle = {SELF, name("oracle")};
+
+      EXPECT(t.error({active(SELF)}, [&](clashdometrn& c) { c.submitscores(id, {{BOB, 10}}); }) == "missing authority of clashdometrn/oracle");
+      EXPECT(t.error({oracle}, [&](clashdometrn& c) { c.submitscores(id, {{DAVE, 10}}); }) == "Account dave has not joined the tournament.");
+
+      t.push({oracle}, [&](clashdometrn& c) { c.submitscores(id, {{BOB, 10}, {CAROL, 20}}); });
+
+      EXPECT(t.error({active(SELF)}, [&](clashdometrn& c) { c.payout(id, 10); }) == "The tournament has not finished yet.");
+
+      t.advance(2 * HOUR);
+
+      size_t sent = t.sent().size();
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.payout(id, 1); });
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.payout(id, 1); });
+
+      // linear weights over a pot of max(10, 2) TLM: carol 2/3, bob 1/3
+      auto paid = t.transfers(sent);
+
+      EXPECT(paid.size() == 2);
+      EXPECT(paid.size() == 2 && paid[0] == std::make_tuple(PAY, CAROL, tlm(66666)));
+      EXPECT(paid.size() == 2 && paid[1] == std::make_tuple(PAY, BOB, tlm(33333)));
+      EXPECT(t.last_sent(name("transfer"))->authorization == std::vector <permission_level>({{PAY, name("active")}}));
+      EXPECT(t.sweep().paid == tlm(99999));
+
+      auto trn = t.tournament(id);
+
+      EXPECT(trn.has_value() && trn->round.has_value() && trn->round.value().status == 2);
+
+      // the pot and the fees minus what was paid go back to the creator
+      EXPECT(t.balance(ALICE) == 10000000 - 100000 + 100000 + 20000 - 99999);
+
+      // a paid round is pruned without refunding the pot again
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.prunetrn(10); });
+
+      EXPECT(!t.tournament(id).has_value());
+      EXPECT(t.balance(ALICE) == 10000000 + 20000 - 99999);
+   }
+
+   void pot_pays_in_its_contract()
+   {
+      tester t = funded();
+
+      // a creator token with the symbol of a global one
+      const name fake = name("fake.tlm");
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.addcreator(BOB, "img", {extended_symbol(TLM, fake)}, false, {}, false, true); });
+      t.push({active(BOB)}, [&](clashdometrn& c) { c.receive_transfer(BOB, SELF, tlm(1000000), "add-funds"); }, fake);
+
+      EXPECT(t.error({active(BOB)}, [&](clashdometrn& c) { 
+         c.receive_transfer(BOB, SELF, tlm(1000000), "add-funds"); 
+      }, TOKEN_CONTRACT) == "The funds of this symbol are held in tokens of another contract.");
+
+      uint64_t id = t.create(BOB, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(10000), tlm(100000));
+
+      EXPECT(t.tournament(id).value().pot_contract.value_or(name()) == fake);
+
+      t.advance(HOUR);
+
+      EXPECT(t.error({active(CAROL)}, [&](clashdometrn& c) { 
+         c.receive_transfer(CAROL, SELF, tlm(10000), "join:" + std::to_string(id)); 
+      }, TOKEN_CONTRACT) == "The entry fee has to be paid in tokens of fake.tlm.");
+
+      t.push({active(CAROL)}, [&](clashdometrn& c) { c.receive_transfer(CAROL, SELF, tlm(10000), "join:" + std::to_string(id)); }, fake);
+      t.push({{SELF, name("oracle")}}, [&](clashdometrn& c) { c.submitscores(id, {{CAROL, 10}}); });
+
+      t.advance(2 * HOUR);
+
+      size_t sent = t.sent().size();
+
+      // the prize and the refund of the creator funds are paid in the tokens the pot was funded with
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.payout(id, 10); });
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.purgecreator(BOB, 10); });
+
+      EXPECT(t.transfers(sent).empty());
+
+      std::vector <std::tuple <name, name, asset>> paid;
+
+      for (size_t i = sent; i < t.sent().size(); i++) {
+         if (t.sent()[i].account == fake && t.sent()[i].name == name("transfer")) {
+            auto [from, to, quantity, memo] = std::any_cast <std::tuple <name, name, asset, std::string>>(t.sent()[i].data);
+            paid.emplace_back(from, to, quantity);
+         }
+      }
+
+      EXPECT(paid == std::vector <std::tuple <name, name, asset>>({{PAY, CAROL, tlm(100000)}, {PAY, BOB, tlm(1000000 - 100000 + 10000)}}));
+   }
+
+   // creates a tournament of bob, who can require nfts, and returns its id or the error
+   std::pair <uint64_t, std::string> create_with_nft(tester& t, uint64_t game, const std::string& requeriment_nft, const asset& fee = tlm(0))
+   {
+      uint64_t id = t.next_id();
+
+      std::string error = t.error({active(BOB)}, [&](clashdometrn& c) {
+         c.createtrn(BOB, "Cup", game, START_TIME + HOUR, START_TIME + 2 * HOUR, fee, tlm(0), requeriment_nft, tlm(0), "MINIMUM", false);
+      });
+
+      return {id, error};
+   }
+
+   void nft_requirement_parsing()
+   {
+      tester t = funded();
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.addcreator(BOB, "img", {}, false, {}, true, true); });
+
+      const std::string format = "Invalid requeriment NFT, the format is collection[:schema[:template_id[:count]]].";
+
+      for (auto [requeriment_nft, error] : std::vector <std::pair <std::string, std::string>>{
+         {"alienworlds:", format},
+         {"alienworlds::12", format},
+         {"alienworlds:*:*:1:1", format},
+         {"AlienWorlds", "Invalid requeriment NFT collection or schema."},
+         {"alienworlds.toolsandmore", "Invalid requeriment NFT collection or schema."},
+         {"alienworlds:tool!", "Invalid requeriment NFT collection or schema."},
+         {"alienworlds:*:-1", "Invalid requeriment NFT template."},
+         {"alienworlds:*:2147483648", "Invalid requeriment NFT template."},
+         {"alienworlds:*:*:0", "Invalid requeriment NFT count."},
+         {"alienworlds:*:*:256", "Invalid requeriment NFT count."}
+      }) {
+         EXPECT(create_with_nft(t, 1, requeriment_nft).second == error);
+      }
+
+      // the collection alone takes any schema and template, one nft
+      auto [any, any_error] = create_with_nft(t, 1, "alienworlds");
+      auto [wildcards, wildcards_error] = create_with_nft(t, 2, "alienworlds:*:*:3");
+      auto [exact, exact_error] = create_with_nft(t, 3, "alienworlds:tools:19553");
+
+      EXPECT(any_error.empty() && wildcards_error.empty() && exact_error.empty());
+
+      std::optional <nft_requirement_row> nft = t.tournament(any).value().requeriment_nft;
+
+      EXPECT(nft.has_value() && nft->collection == name("alienworlds") && nft->schema == name() && nft->template_id == -1 && nft->count == 1);
+
+      nft = t.tournament(wildcards).value().requeriment_nft;
+
+      EXPECT(nft.has_value() && nft->schema == name() && nft->template_id == -1 && nft->count == 3);
+
+      nft = t.tournament(exact).value().requeriment_nft;
+
+      EXPECT(nft.has_value() && nft->schema == name("tools") && nft->template_id == 19553 && nft->count == 1);
+   }
+
+   void nft_locks_and_joins()
+   {
+      tester t = funded();
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.addcreator(BOB, "img", {}, false, {}, true, true); });
+
+      uint64_t with_fee = create_with_nft(t, 1, "alienworlds:tools:*:2", tlm(10000)).first;
+      uint64_t nft_only = create_with_nft(t, 2, "alienworlds").first;
+
+      // the nfts are owned by the contract when the notification arrives
+      {
+         multi_index <name("assets"), nft_asset_row> assets(name("atomicassets"), SELF.value);
+
+         for (nft_asset_row nft : std::vector <nft_asset_row>{
+            {1, name("alienworlds"), name("tools"), 19553}, 
+            {2, name("alienworlds"), name("tools"), 19554}, 
+            {3, name("alienworlds"), name("lands"), 19553},
+            {4, name("alienworlds"), name("lands"), 19555}
+         }) {
+            assets.emplace(SELF, [&](nft_asset_row& ast) { ast = nft; });
+         }
+      }
+
+      auto send_nfts = [&](name from, const std::vector <uint64_t>& asset_ids, const std::string& memo) {
+         return t.error({active(from)}, [&](clashdometrn& c) { c.receive_nft(from, SELF, asset_ids, memo); }, name("atomicassets"));
+      };
+
+      t.advance(HOUR);
+
+      // nfts sent for anything but joining are left alone
+      EXPECT(send_nfts(CAROL, {1}, "gift").empty());
+      EXPECT(rows <name("nftlocks"), nftlock_row>(SELF, with_fee).empty());
+
+      EXPECT(send_nfts(CAROL, {3}, "join:" + std::to_string(with_fee)) == "Asset 3 doesn't meet the NFT requirement.");
+      EXPECT(t.error({active(CAROL)}, [&](clashdometrn& c) {
+         c.receive_transfer(CAROL, SELF, tlm(10000), "join:" + std::to_string(with_fee));
+      }, TOKEN_CONTRACT) == "Lock the required NFTs before paying the entry fee.");
+
+      // with a fee the entry waits for the payment, after all the nfts are locked
+      EXPECT(send_nfts(CAROL, {1}, "join:" + std::to_string(with_fee)).empty());
+      EXPECT(t.error({active(CAROL)}, [&](clashdometrn& c) {
+         c.receive_transfer(CAROL, SELF, tlm(10000), "join:" + std::to_string(with_fee));
+      }, TOKEN_CONTRACT) == "Lock the required NFTs before paying the entry fee.");
+
+      EXPECT(send_nfts(CAROL, {2}, "join:" + std::to_string(with_fee)).empty());
+      EXPECT(rows <name("entries"), entry_row>(SELF, with_fee).empty());
+
+      t.transfer(CAROL, tlm(10000), "join:" + std::to_string(with_fee));
+
+      auto locks = rows <name("nftlocks"), nftlock_row>(SELF, with_fee);
+      auto entry = row <name("entries"), entry_row>(SELF, with_fee, CAROL.value);
+
+      EXPECT(locks.size() == 2 && locks[0].account == CAROL && locks[1].round_start == START_TIME + HOUR);
+      EXPECT(entry.has_value() && entry->fee == tlm(10000) && t.tournament(with_fee).value().round.value().entries == 1);
+
+      // without a fee locking the nfts is the entry
+      EXPECT(send_nfts(DAVE, {4}, "join:" + std::to_string(nft_only)).empty());
+      EXPECT(row <name("entries"), entry_row>(SELF, nft_only, DAVE.value).has_value());
+      EXPECT(t.tournament(nft_only).value().round.value().entries == 1);
+   }
+
+   void commit_and_claim()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(100000));
+
+      t.advance(3 * HOUR);
+
+      uint32_t round_start = START_TIME + HOUR;
+
+      checksum256 bob_leaf = leaf(id, round_start, 0, BOB, tlm(40000));
+      checksum256 carol_leaf = leaf(id, round_start, 1, CAROL, tlm(20000));
+      checksum256 root = parent(bob_leaf, carol_leaf);
+
+      permission_level oracle = {SELF, name("oracle")};
+
+      t.push({oracle}, [&](clashdometrn& c) { c.commitres(id, root, tlm(60000)); });
+
+      // what the results don't pay goes back right away
+      EXPECT(t.balance(ALICE) == 10000000 - 100000 + 40000);
+
+      size_t sent = t.sent().size();
+
+      EXPECT(t.error({active(BOB)}, [&](clashdometrn& c) { c.claim(id, round_start, BOB, tlm(50000), 0, {carol_leaf}); }) == "Invalid proof.");
+
+      t.push({active(BOB)}, [&](clashdometrn& c) { c.claim(id, round_start, BOB, tlm(40000), 0, {carol_leaf}); });
+
+      EXPECT(t.transfers(sent) == std::vector <std::tuple <name, name, asset>>({{PAY, BOB, tlm(40000)}}));
+      EXPECT(t.error({active(BOB)}, [&](clashdometrn& c) { c.claim(id, round_start, BOB, tlm(40000), 0, {carol_leaf}); }) == "Prize already claimed.");
+
+      t.advance(31 * DAY);
+
+      EXPECT(t.error({active(CAROL)}, [&](clashdometrn& c) { c.claim(id, round_start, CAROL, tlm(20000), 1, {bob_leaf}); }) == "The claim period of this tournament round is over.");
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.pruneresults(id, 10); });
+
+      EXPECT(rows <name("results"), result_row>(SELF, id).empty());
+      EXPECT(rows <name("claims"), claim_row>(SELF, id).empty());
+      EXPECT(t.balance(ALICE) == 10000000 - 100000 + 40000 + 20000);
+   }
+
+   void purgecreator_refunds()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(100000));
+
+      size_t sent = t.sent().size();
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.purgecreator(ALICE, 10); });
+
+      EXPECT(!t.tournament(id).has_value());
+      EXPECT(!t.has_balance_row(ALICE));
+      EXPECT(rows <name("tokens"), token_row>(SELF, ALICE.value).empty());
+      EXPECT(rows <name("creators"), creator_row>(SELF, SELF.value).empty());
+      EXPECT(rows <name("purges"), purge_row>(SELF, SELF.value).empty());
+
+      // the funds, with the prize pot refunded, are paid back by clashdomepay
+      EXPECT(t.transfers(sent) == std::vector <std::tuple <name, name, asset>>({{PAY, ALICE, tlm(10000000)}}));
+      EXPECT(t.sweep().paid == tlm(10000000));
+   }
+
+   void purgecreator_in_steps()
+   {
+      tester t = funded();
+
+      for (uint32_t game = 1; game <= 4; game++) {
+         t.create(ALICE, "Cup", game, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(10000));
+      }
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.purgecreator(ALICE, 3); });
+
+      EXPECT(rows <name("purges"), purge_row>(SELF, SELF.value).size() == 1);
+      EXPECT(rows <name("creators"), creator_row>(SELF, SELF.value).size() == 1);
+
+      // the last tournament, the balance and the creator fit in the second call
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.purgecreator(ALICE, 3); });
+
+      EXPECT(rows <name("purges"), purge_row>(SELF, SELF.value).empty());
+      EXPECT(rows <name("creators"), creator_row>(SELF, SELF.value).empty());
+      EXPECT(t.sweep().paid == tlm(10000000));
+   }
+
+   void purgecreator_rechecks_balances()
+   {
+      tester t = funded();
+
+      // a purge past its balances stage, as when the creator was credited after it
+      {
+         multi_index <name("purges"), purge_row> purges(SELF, SELF.value);
+         purges.emplace(SELF, [&](purge_row& prg) { prg = purge_row{ALICE, 2, 0}; });
+      }
+
+      // nothing new can be left behind by the purge
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.createtrn(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0), "", tlm(10000), "MINIMUM", false);
+      }) == "The creator is being purged.");
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.receive_transfer(ALICE, SELF, tlm(10000), "add-funds");
+      }, TOKEN_CONTRACT) == "The creator is being purged.");
+
+      // the creator is kept and the purge goes back to refund the balance
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.purgecreator(ALICE, 10); });
+
+      EXPECT(row <name("purges"), purge_row>(SELF, SELF.value, ALICE.value).value().stage == 1);
+      EXPECT(rows <name("creators"), creator_row>(SELF, SELF.value).size() == 1);
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.purgecreator(ALICE, 10); });
+
+      EXPECT(rows <name("purges"), purge_row>(SELF, SELF.value).empty());
+      EXPECT(rows <name("creators"), creator_row>(SELF, SELF.value).empty());
+      EXPECT(!t.has_balance_row(ALICE));
+      EXPECT(t.sweep().paid == tlm(10000000));
+   }
+
+   void rmcreator_spent_balances()
+   {
+      tester t = funded();
+      t.add_creator(BOB);
+
+      // a balance spent down to zero keeps its row
+      {
+         multi_index <name("balances"), balance_row> balances(SELF, BOB.value);
+         balances.emplace(SELF, [&](balance_row& bal) { bal.funds = tlm(0); });
+      }
+
+      EXPECT(t.error({active(SELF)}, [&](clashdometrn& c) { c.rmcreator(ALICE); }) == "The creator still has tournaments or funds, use purgecreator.");
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.rmcreator(BOB); });
+
+      EXPECT(!row <name("creators"), creator_row>(SELF, SELF.value, BOB.value).has_value());
+      EXPECT(!t.has_balance_row(BOB));
+   }
+
+   void interned_names()
+   {
+      tester t = funded();
+
+      uint64_t first = t.create(ALICE, "Weekly championship", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+      uint64_t second = t.create(ALICE, "Weekly championship", 2, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+      uint64_t short_name = t.create(ALICE, "Cup", 3, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+
+      auto strings = rows <name("strings"), string_row>(SELF, SELF.value);
+
+      EXPECT(strings.size() == 1 && strings[0].value == "Weekly championship" && strings[0].refs == 2);
+      EXPECT(t.tournament(first)->trn_name.empty() && t.tournament(first)->name_ref.value_or(0) == strings[0].id);
+      EXPECT(t.tournament(short_name)->trn_name == "Cup" && t.tournament(short_name)->name_ref.value_or(0) == 0);
+
+      clashdometrn::trn_page page = t.push({}, [&](clashdometrn& c) { return c.listupcoming(1, 0, 10, 0); });
+
+      EXPECT(page.tournaments.size() == 1 && page.tournaments[0].name == "Weekly championship");
+
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.canceltrn(ALICE, first); });
+
+      strings = rows <name("strings"), string_row>(SELF, SELF.value);
+
+      EXPECT(strings.size() == 1 && strings[0].refs == 1);
+
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.canceltrn(ALICE, second); });
+
+      EXPECT(rows <name("strings"), string_row>(SELF, SELF.value).empty());
+   }
+
+   void modlog_sequences()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.rmusertrns(ALICE, id, {BOB, CAROL}, "cheating"); });
+
+      t.advance(31 * DAY);
+
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.rmusertrn(ALICE, DAVE, id, "cheating"); });
+
+      // each new record expires one old one, the sequences go on after them
+      auto records = rows <name("modlog"), modlog_row>(SELF, id);
+
+      EXPECT(records.size() == 2 && records[0].sequence == 1 && records[1].sequence == 2 && records[1].account == DAVE);
+
+      t.advance(31 * DAY);
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.prunemodlog(id, 10); });
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.rmusertrn(ALICE, BOB, id, "cheating"); });
+
+      records = rows <name("modlog"), modlog_row>(SELF, id);
+
+      EXPECT(records.size() == 1 && records[0].sequence == 3);
+   }
+
+   void fcanceltrn_refuses_entries()
+   {
+      tester t = funded();
+
+      uint64_t id = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(10000), tlm(100000));
+
+      t.advance(HOUR);
+      t.transfer(BOB, tlm(10000), "join:" + std::to_string(id));
+
+      EXPECT(t.error({active(SELF)}, [&](clashdometrn& c) { c.fcanceltrn(ALICE, id); }) == "You cannot cancel a tournament with entries.");
+
+      uint64_t empty = t.create(ALICE, "Cup", 2, START_TIME + 2 * HOUR, START_TIME + 3 * HOUR, tlm(0), tlm(50000));
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.fcanceltrn(ALICE, empty); });
+
+      EXPECT(!t.tournament(empty).has_value());
+      EXPECT(t.balance(ALICE) == 10000000 - 100000);
+   }
+
+   void sweep_threshold()
+   {
+      tester t = funded();
+
+      t.push({active(SELF)}, [&](clashdometrn& c) { c.setsweep(extended_symbol(TLM, TOKEN_CONTRACT), tlm(50000)); });
+
+      t.deposit(ALICE, tlm(30000));
+
+      EXPECT(t.sweep().pending == tlm(30000));
+
+      t.deposit(ALICE, tlm(30000));
+
+      EXPECT(t.sweep().pending == tlm(0));
+      EXPECT(t.sweep().swept == tlm(10000000 + 60000));
+      EXPECT(t.sweep().deposited == tlm(10000000 + 60000));
+   }
+
+   void balances_without_changes()
+   {
+      tester t;
+      t.init();
+      t.add_creator(BOB);
+
+      t.create(BOB, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0));
+
+      EXPECT(!t.has_balance_row(BOB));
+   }
+
+   void migratetkns_logs_conflicts()
+   {
+      tester t;
+      t.init();
+      t.add_creator(ALICE);
+
+      const extended_symbol wax = extended_symbol(symbol(symbol_code("WAX"), 8), name("eosio.token"));
+      const extended_symbol other_tlm = extended_symbol(TLM, name("fake.tlm"));
+
+      // the token vectors of the config and creator rows before the tokens table
+      {
+         singleton <name("config"), config_row> config(SELF, SELF.value);
+         config_row legacy_config = config.get();
+         legacy_config.supported_tokens_fee = {wax, extended_symbol(TLM, TOKEN_CONTRACT), wax};
+         legacy_config.supported_tokens_stake = {other_tlm};
+         config.set(legacy_config, SELF);
+
+         multi_index <name("creators"), creator_row> creators(SELF, SELF.value);
+         creators.modify(creators.find(ALICE.value), SELF, [&](creator_row& cr) { cr.supported_tokens_stake = {wax}; });
+      }
+
+      size_t sent = t.sent().size();
+
+      t.push({active(SELF)}, [](clashdometrn& c) { c.migratetkns(10); });
+
+      EXPECT(row <name("tokens"), token_row>(SELF, SELF.value, wax.get_symbol().raw()).value().type == 1);
+      EXPECT(row <name("tokens"), token_row>(SELF, ALICE.value, wax.get_symbol().raw()).value().type == 2);
+      config_row migrated_config = singleton <name("config"), config_row>(SELF, SELF.value).get();
+
+      EXPECT(migrated_config.supported_tokens_fee.empty() && migrated_config.supported_tokens_stake.empty());
+      EXPECT(row <name("creators"), creator_row>(SELF, SELF.value, ALICE.value).value().supported_tokens_stake.empty());
+
+      // TLM stays supported from alien.worlds, the other contract is logged instead of silently dropped
+      EXPECT(row <name("tokens"), token_row>(SELF, SELF.value, TLM.raw()).value().token == extended_symbol(TLM, TOKEN_CONTRACT));
+
+      const host::sent_action* log = t.last_sent(name("logtknskip"), sent);
+
+      EXPECT(log != nullptr);
+
+      if (log != nullptr) {
+         auto [skipped] = std::any_cast <std::tuple <std::vector <clashdometrn::skipped_token>>>(log->data);
+
+         EXPECT(skipped.size() == 1 && skipped[0].scope == SELF && skipped[0].token == other_tlm && skipped[0].type == 2);
+      }
+   }
+
+   void migratefnds_moves_funds()
+   {
+      tester t = funded();
+      t.add_creator(BOB);
+
+      const asset wax = asset(500000000, symbol(symbol_code("WAX"), 8));
+
+      // the funds vectors of the creator rows before the balances table
+      {
+         multi_index <name("creators"), creator_row> creators(SELF, SELF.value);
+         creators.modify(creators.find(ALICE.value), SELF, [&](creator_row& cr) { cr.funds = {tlm(25000), wax}; });
+         creators.modify(creators.find(BOB.value), SELF, [&](creator_row& cr) { cr.funds = {tlm(40000)}; });
+      }
+
+      // one creator per call, the funds add to the balances already there
+      t.push({active(SELF)}, [](clashdometrn& c) { c.migratefnds(1); });
+
+      EXPECT(t.balance(ALICE) == 10000000 + 25000);
+      EXPECT(row <name("balances"), balance_row>(SELF, ALICE.value, wax.symbol.code().raw()).value().funds == wax);
+      EXPECT(row <name("creators"), creator_row>(SELF, SELF.value, ALICE.value).value().funds.empty());
+      EXPECT(t.balance(BOB) == 0);
+
+      t.push({active(SELF)}, [](clashdometrn& c) { c.migratefnds(1); });
+
+      EXPECT(t.balance(BOB) == 40000);
+      EXPECT(row <name("creators"), creator_row>(SELF, SELF.value, BOB.value).value().funds.empty());
+   }
+
+   void migratetrn_drops_malformed_nfts()
+   {
+      tester t = funded();
+
+      // rows of the legacy table, their requirements were stored unchecked
+      {
+         legacy_tournaments_table legacy(SELF, SELF.value);
+
+         for (auto [id, game, nft] : std::vector <std::tuple <uint64_t, uint64_t, std::string>>{
+            {100, 1, ""}, {101, 2, "bad name!"}, {102, 3, "alienworlds:*:12:2"}
+         }) {
+            legacy.emplace(SELF, [&](legacy_tournament_row& trn) {
+               trn = legacy_tournament_row{id, ALICE, "Cup", game, START_TIME + HOUR, START_TIME + 2 * HOUR, 
+                  tlm(0), tlm(0), nft, tlm(10000), "MINIMUM", false};
+            });
+         }
+      }
+
+      // rows not moved yet are still seen by the overlap check
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.createtrn(ALICE, "Cup", 2, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0), "", tlm(10000), "MINIMUM", false);
+      }) == "Two tournaments at same time are not allowed.");
+
+      size_t sent = t.sent().size();
+
+      // the malformed requirement doesn't block the rows after it
+      t.push({active(SELF)}, [](clashdometrn& c) { c.migratetrn(10); });
+
+      legacy_tournaments_table legacy(SELF, SELF.value);
+
+      EXPECT(legacy.begin() == legacy.end());
+      EXPECT(t.tournament(100).has_value() && !t.tournament(100)->requeriment_nft.has_value());
+      EXPECT(t.tournament(101).has_value() && !t.tournament(101)->requeriment_nft.has_value());
+
+      std::optional <nft_requirement_row> nft = t.tournament(102).value().requeriment_nft;
+
+      EXPECT(nft.has_value() && nft->collection == name("alienworlds") && nft->schema == name());
+      EXPECT(nft.has_value() && nft->template_id == 12 && nft->count == 2);
+
+      const host::sent_action* log = t.last_sent(name("lognftdrop"), sent);
+
+      EXPECT(log != nullptr);
+
+      if (log != nullptr) {
+         auto [dropped] = std::any_cast <std::tuple <std::vector <clashdometrn::dropped_nft>>>(log->data);
+
+         EXPECT(dropped.size() == 1 && dropped[0].tournament_id == 101 && dropped[0].requeriment_nft == "bad name!");
+      }
+   }
+
+#ifdef CLASHDOME_GAME_SCOPES
+   // moves every tournament to the contract scope and drops the trngames directory, as a deployment 
+   // without per-game scopes left the tables
+   void unscope()
+   {
+      auto& tables = host::state().tables;
+      host::table_key self_key = {SELF.value, SELF.value, name("tournaments2").value};
+
+      for (uint64_t game = 1; game <= 6; game++) {
+         auto itr = tables.find(host::table_key{SELF.value, game, name("tournaments2").value});
+
+         if (itr == tables.end()) {
+            continue;
+         }
+
+         host::table game_table = itr->second;
+         tables.erase(itr);
+
+         for (auto& [pk, trn] : game_table.rows) {
+            host::store(self_key, host::get_table(self_key, game_table.indices.size()), pk, trn);
+         }
+      }
+
+      tables.erase(host::table_key{SELF.value, SELF.value, name("trngames").value});
+   }
+
+   void migratescope_moves_tournaments()
+   {
+      tester t = funded();
+
+      uint64_t first = t.create(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(10000));
+      uint64_t second = t.create(ALICE, "Cup", 2, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(10000));
+      uint64_t third = t.create(ALICE, "Cup", 3, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(10000));
+
+      unscope();
+
+      // rows not moved yet are still found in the contract scope
+      EXPECT(t.tournament(first).has_value() && t.tournament(first)->game == 1);
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.createtrn(ALICE, "Cup", 1, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0), "", tlm(10000), "MINIMUM", false);
+      }) == "Two tournaments at same time are not allowed.");
+
+      t.push({active(SELF)}, [](clashdometrn& c) { c.migratescope(2); });
+
+      EXPECT(rows <name("tournaments2"), tournament_row>(SELF, SELF.value).size() == 1);
+      EXPECT(row <name("tournaments2"), tournament_row>(SELF, 1, first).has_value());
+      EXPECT(row <name("trngames"), trngame_row>(SELF, SELF.value, second).value().game == 2);
+
+      t.push({active(SELF)}, [](clashdometrn& c) { c.migratescope(10); });
+
+      EXPECT(rows <name("tournaments2"), tournament_row>(SELF, SELF.value).empty());
+      EXPECT(rows <name("tournaments2"), tournament_row>(SELF, 3).size() == 1);
+
+      // moved rows are found by id and by the overlap check
+      t.push({active(ALICE)}, [&](clashdometrn& c) { c.canceltrn(ALICE, third); });
+
+      EXPECT(!t.tournament(third).has_value());
+      EXPECT(t.error({active(ALICE)}, [&](clashdometrn& c) {
+         c.createtrn(ALICE, "Cup", 2, START_TIME + HOUR, START_TIME + 2 * HOUR, tlm(0), tlm(0), "", tlm(10000), "MINIMUM", false);
+      }) == "Two tournaments at same time are not allowed.");
+   }
+#endif
+}
+
+int main()
+{
+   const std::vector <std::pair <const char*, std::function <void()>>> tests = {
+      {"create_and_cancel", create_and_cancel},
+      {"failed_action_rolls_back", failed_action_rolls_back},
+      {"overlap_check", overlap_check},
+      {"listupcoming_pages", listupcoming_pages},
+      {"listbycr_pages", listbycr_pages},
+      {"queries_are_read_only", queries_are_read_only},
+      {"prunetrn_refunds_and_resumes", prunetrn_refunds_and_resumes},
+      {"rollover_keeps_the_pot", rollover_keeps_the_pot},
+      {"join_and_payout", join_and_payout},
+      {"pot_pays_in_its_contract", pot_pays_in_its_contract},
+      {"nft_requirement_parsing", nft_requirement_parsing},
+      {"nft_locks_and_joins", nft_locks_and_joins},
+      {"commit_and_claim", commit_and_claim},
+      {"purgecreator_refunds", purgecreator_refunds},
+      {"purgecreator_in_steps", purgecreator_in_steps},
+      {"purgecreator_rechecks_balances", purgecreator_rechecks_balances},
+      {"rmcreator_spent_balances", rmcreator_spent_balances},
+      {"interned_names", interned_names},
+      {"modlog_sequences", modlog_sequences},
+      {"fcanceltrn_refuses_entries", fcanceltrn_refuses_entries},
+      {"sweep_threshold", sweep_threshold},
+      {"balances_without_changes", balances_without_changes},
+      {"migratetkns_logs_conflicts", migratetkns_logs_conflicts},
+      {"migratefnds_moves_funds", migratefnds_moves_funds},
+      {"migratetrn_drops_malformed_nfts", migratetrn_drops_malformed_nfts},
+#ifdef CLASHDOME_GAME_SCOPES
+      {"migratescope_moves_tournaments", migratescope_moves_tournaments},
+#endif
+   };
+
+   for (const auto& [test_name, test] : tests) {
+      int before = failures;
+
+      try {
+         test();
+      } catch (const std::exception& e) {
+         std::printf("   unexpected error: %s\n", e.what());
+         failures++;
+      }
+
+      std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", test_name);
+   }
+
+   return failures == 0 ? 0 : 1;
+}
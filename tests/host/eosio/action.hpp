@@ -0,0 +1,65 @@
+#pragma once
+
+#include <any>
+#include <utility>
+#include <vector>
+
+#include <eosio/check.hpp>
+#include <eosio/host.hpp>
+#include <eosio/name.hpp>
+
+namespace eosio {
+
+   // inline actions are not run, send logs them for the tester to inspect
+   struct action {
+
+      std::vector <permission_level> authorization;
+      eosio::name account;
+      eosio::name name;
+      std::any data;
+
+      action() = default;
+
+      template <typename T>
+      action(const permission_level& auth, struct name a, struct name n, T&& value)
+         : authorization{auth}, account(a), name(n), data(std::forward <T>(value)) {}
+
+      template <typename T>
+      action(std::vector <permission_level> auths, struct name a, struct name n, T&& value)
+         : authorization(std::move(auths)), account(a), name(n), data(std::forward <T>(value)) {}
+
+      void send() const
+      {
+         host::state().sent.push_back(host::sent_action{authorization, account, name, data});
+      }
+   };
+
+   inline bool has_auth(name n)
+   {
+      for (const permission_level& auth : host::state().auths) {
+         if (auth.actor == n) {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   inline void require_auth(name n)
+   {
+      if (!has_auth(n)) {
+         check(false, "missing authority of " + n.to_string());
+      }
+   }
+
+   inline void require_auth(const permission_level& level)
+   {
+      for (const permission_level& auth : host::state().auths) {
+         if (auth == level) {
+            return;
+         }
+      }
+
+      check(false, "missing authority of " + level.actor.to_string() + "/" + level.permission.to_string());
+   }
+}
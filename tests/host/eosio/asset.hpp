@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include <eosio/check.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/symbol.hpp>
+
+namespace eosio {
+
+   // amount of a symbol, arithmetic and comparisons check that the symbols match like the cdt does
+   struct asset {
+
+      static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+      int64_t amount = 0;
+      eosio::symbol symbol;
+
+      asset() = default;
+
+      asset(int64_t a, eosio::symbol s) : amount(a), symbol(s)
+      {
+         check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+         check(symbol.is_valid(), "invalid symbol name");
+      }
+
+      bool is_amount_within_range() const { return -max_amount <= amount && amount <= max_amount; }
+
+      bool is_valid() const { return is_amount_within_range() && symbol.is_valid(); }
+
+      asset operator-() const { return asset(-amount, symbol); }
+
+      asset& operator-=(const asset& a)
+      {
+         check(a.symbol == symbol, "attempt to subtract asset with different symbol");
+         amount -= a.amount;
+         check(-max_amount <= amount, "subtraction underflow");
+         check(amount <= max_amount, "subtraction overflow");
+         return *this;
+      }
+
+      asset& operator+=(const asset& a)
+      {
+         check(a.symbol == symbol, "attempt to add asset with different symbol");
+         amount += a.amount;
+         check(-max_amount <= amount, "addition underflow");
+         check(amount <= max_amount, "addition overflow");
+         return *this;
+      }
+
+      asset& operator*=(int64_t a)
+      {
+         int128_t tmp = (int128_t) amount * (int128_t) a;
+         check(tmp <= max_amount, "multiplication overflow");
+         check(tmp >= -max_amount, "multiplication underflow");
+         amount = (int64_t) tmp;
+         return *this;
+      }
+
+      asset& operator/=(int64_t a)
+      {
+         check(a != 0, "divide by zero");
+         check(!(amount == std::numeric_limits <int64_t>::min() && a == -1), "signed division overflow");
+         amount /= a;
+         return *this;
+      }
+
+      friend asset operator+(const asset& a, const asset& b)
+      {
+         asset result = a;
+         result += b;
+         return result;
+      }
+
+      friend asset operator-(const asset& a, const asset& b)
+      {
+         asset result = a;
+         result -= b;
+         return result;
+      }
+
+      friend asset operator*(const asset& a, int64_t b)
+      {
+         asset result = a;
+         result *= b;
+         return result;
+      }
+
+      friend asset operator*(int64_t b, const asset& a) { return a * b; }
+
+      friend asset operator/(const asset& a, int64_t b)
+      {
+         asset result = a;
+         result /= b;
+         return result;
+      }
+
+      friend int64_t operator/(const asset& a, const asset& b)
+      {
+         check(b.amount != 0, "divide by zero");
+         check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+         return a.amount / b.amount;
+      }
+
+      friend bool operator==(const asset& a, const asset& b)
+      {
+         check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+         return a.amount == b.amount;
+      }
+
+      friend bool operator!=(const asset& a, const asset& b) { return !(a == b); }
+
+      friend bool operator<(const asset& a, const asset& b)
+      {
+         check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+         return a.amount < b.amount;
+      }
+
+      friend bool operator<=(const asset& a, const asset& b) { return !(b < a); }
+      friend bool operator>(const asset& a, const asset& b) { return b < a; }
+      friend bool operator>=(const asset& a, const asset& b) { return !(a < b); }
+
+      std::string to_string() const
+      {
+         uint8_t precision = symbol.precision();
+         bool negative = amount < 0;
+         uint64_t abs_amount = negative ? -(uint64_t) amount : (uint64_t) amount;
+
+         std::string digits = std::to_string(abs_amount);
+
+         if (precision > 0) {
+            if (digits.size() <= precision) {
+               digits.insert(0, precision + 1 - digits.size(), '0');
+            }
+
+            digits.insert(digits.size() - precision, ".");
+         }
+
+         return (negative ? "-" : "") + digits + " " + symbol.code().to_string();
+      }
+
+      template <typename Stream>
+      friend datastream <Stream>& operator<<(datastream <Stream>& ds, const asset& value)
+      {
+         return ds << value.amount << value.symbol;
+      }
+
+      template <typename Stream>
+      friend datastream <Stream>& operator>>(datastream <Stream>& ds, asset& value)
+      {
+         return ds >> value.amount >> value.symbol;
+      }
+   };
+
+   // asset and the token contract issuing it
+   struct extended_asset {
+
+      asset quantity;
+      name contract;
+
+      extended_asset() = default;
+
+      extended_asset(int64_t v, extended_symbol s) : quantity(v, s.get_symbol()), contract(s.get_contract()) {}
+
+      extended_asset(asset a, name c) : quantity(a), contract(c) {}
+
+      extended_symbol get_extended_symbol() const { return extended_symbol(quantity.symbol, contract); }
+
+      std::string to_string() const { return quantity.to_string() + "@" + contract.to_string(); }
+
+      template <typename Stream>
+      friend datastream <Stream>& operator<<(datastream <Stream>& ds, const extended_asset& value)
+      {
+         return ds << value.quantity << value.contract;
+      }
+
+      template <typename Stream>
+      friend datastream <Stream>& operator>>(datastream <Stream>& ds, extended_asset& value)
+      {
+         return ds >> value.quantity >> value.contract;
+      }
+   };
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+
+#include <eosio/check.hpp>
+#include <eosio/datastream.hpp>
+
+namespace eosio {
+
+   // trailing field added after rows were written, packed only when present and read only when bytes remain
+   template <typename T>
+   class binary_extension {
+
+      public:
+
+         binary_extension() = default;
+
+         binary_extension(const T& value) : _value(value) {}
+
+         binary_extension(T&& value) : _value(std::move(value)) {}
+
+         binary_extension& operator=(const T& value)
+         {
+            _value = value;
+            return *this;
+         }
+
+         binary_extension& operator=(T&& value)
+         {
+            _value = std::move(value);
+            return *this;
+         }
+
+         bool has_value() const { return _value.has_value(); }
+
+         explicit operator bool() const { return has_value(); }
+
+         T& value()
+         {
+            check(has_value(), "binary extension not present");
+            return *_value;
+         }
+
+         const T& value() const
+         {
+            check(has_value(), "binary extension not present");
+            return *_value;
+         }
+
+         template <typename U>
+         T value_or(U&& def) const
+         {
+            return has_value() ? *_value : static_cast <T>(std::forward <U>(def));
+         }
+
+         T value_or() const { return has_value() ? *_value : T(); }
+
+         template <typename... Args>
+         T& emplace(Args&&... args)
+         {
+            return _value.emplace(std::forward <Args>(args)...);
+         }
+
+         void reset() { _value.reset(); }
+
+         T& operator*() { return value(); }
+
+         const T& operator*() const { return value(); }
+
+      private:
+
+         std::optional <T> _value;
+   };
+
+   template <typename Stream, typename T>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const binary_extension <T>& value)
+   {
+      if (value.has_value()) {
+         ds << value.value();
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename T>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, binary_extension <T>& value)
+   {
+      if (ds.remaining() > 0) {
+         T element{};
+         ds >> element;
+         value = std::move(element);
+      } else {
+         value.reset();
+      }
+
+      return ds;
+   }
+}
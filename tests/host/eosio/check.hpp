@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// host stand-in for the cdt headers, failed checks throw so the tester can roll the action back
+namespace eosio {
+
+   struct check_failure : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline void check(bool pred, const char* msg)
+   {
+      if (!pred) {
+         throw check_failure(msg);
+      }
+   }
+
+   inline void check(bool pred, const std::string& msg)
+   {
+      if (!pred) {
+         throw check_failure(msg);
+      }
+   }
+
+   inline void check(bool pred, std::string_view msg)
+   {
+      if (!pred) {
+         throw check_failure(std::string(msg));
+      }
+   }
+}
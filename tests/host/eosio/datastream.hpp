@@ -0,0 +1,427 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <eosio/check.hpp>
+#include <eosio/name.hpp>
+
+typedef unsigned __int128 uint128_t;
+typedef __int128 int128_t;
+
+namespace eosio {
+
+   // reads from a const char* buffer, writes to a char* buffer, or only counts the bytes with size_t
+   template <typename T>
+   class datastream {
+
+      public:
+
+         datastream(T start, size_t size) : _start(start), _pos(start), _end(start + size) {}
+
+         void write(const char* data, size_t size)
+         {
+            check(size <= remaining(), "datastream attempted to write past the end");
+            std::memcpy(_pos, data, size);
+            _pos += size;
+         }
+
+         void read(char* data, size_t size)
+         {
+            check(size <= remaining(), "datastream attempted to read past the end");
+            std::memcpy(data, _pos, size);
+            _pos += size;
+         }
+
+         size_t remaining() const { return _end - _pos; }
+
+         size_t tellp() const { return _pos - _start; }
+
+      private:
+
+         T _start;
+         T _pos;
+         T _end;
+   };
+
+   template <>
+   class datastream <size_t> {
+
+      public:
+
+         datastream(size_t init = 0) : _size(init) {}
+
+         void write(const char*, size_t size) { _size += size; }
+
+         size_t remaining() const { return 0; }
+
+         size_t tellp() const { return _size; }
+
+      private:
+
+         size_t _size;
+   };
+
+   namespace reflect {
+
+      // converts to any field type, used to count the fields of an aggregate
+      struct any_field {
+         template <typename U>
+         operator U() const;
+      };
+
+      template <typename T, size_t... I>
+      constexpr auto constructible(std::index_sequence <I...>) -> decltype(T{(void(I), any_field{})...}, true) { return true; }
+
+      template <typename T>
+      constexpr bool constructible(...) { return false; }
+
+      template <typename T, size_t N = 16>
+      constexpr size_t field_count()
+      {
+         if constexpr (N == 0) {
+            return 0;
+         } else if constexpr (constructible <T>(std::make_index_sequence <N>{})) {
+            return N;
+         } else {
+            return field_count <T, N - 1>();
+         }
+      }
+
+      // calls f with every field of an aggregate, in declaration order
+      template <typename T, typename F>
+      void for_each_field(T& value, F&& f)
+      {
+         constexpr size_t count = field_count <std::remove_const_t <T>>();
+         static_assert(count > 0, "only aggregates with up to 16 fields can be serialized");
+
+      if constexpr (count == 1) {
+         auto& [f0] = value;
+         f(f0);
+      } else if constexpr (count == 2) {
+         auto& [f0, f1] = value;
+         f(f0); f(f1);
+      } else if constexpr (count == 3) {
+         auto& [f0, f1, f2] = value;
+         f(f0); f(f1); f(f2);
+      } else if constexpr (count == 4) {
+         auto& [f0, f1, f2, f3] = value;
+         f(f0); f(f1); f(f2); f(f3);
+      } else if constexpr (count == 5) {
+         auto& [f0, f1, f2, f3, f4] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4);
+      } else if constexpr (count == 6) {
+         auto& [f0, f1, f2, f3, f4, f5] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5);
+      } else if constexpr (count == 7) {
+         auto& [f0, f1, f2, f3, f4, f5, f6] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6);
+      } else if constexpr (count == 8) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7);
+      } else if constexpr (count == 9) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8);
+      } else if constexpr (count == 10) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9);
+      } else if constexpr (count == 11) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10);
+      } else if constexpr (count == 12) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11);
+      } else if constexpr (count == 13) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12);
+      } else if constexpr (count == 14) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13);
+      } else if constexpr (count == 15) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14);
+      } else if constexpr (count == 16) {
+         auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15] = value;
+         f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15);
+      }
+   }
+
+      template <typename T>
+      struct is_array : std::false_type {};
+
+      template <typename T, size_t N>
+      struct is_array <std::array <T, N>> : std::true_type {};
+
+      template <typename T>
+      constexpr bool is_reflected = std::is_class_v <T> && std::is_aggregate_v <T> && !is_array <T>::value;
+   }
+
+   // integers, bools and enums are stored little endian at their own size
+   template <typename Stream, typename T, std::enable_if_t <std::is_arithmetic_v <T> || std::is_enum_v <T>, int> = 0>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const T& value)
+   {
+      ds.write(reinterpret_cast <const char*>(&value), sizeof(T));
+      return ds;
+   }
+
+   template <typename Stream, typename T, std::enable_if_t <std::is_arithmetic_v <T> || std::is_enum_v <T>, int> = 0>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, T& value)
+   {
+      ds.read(reinterpret_cast <char*>(&value), sizeof(T));
+      return ds;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const uint128_t& value)
+   {
+      ds.write(reinterpret_cast <const char*>(&value), sizeof(value));
+      return ds;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, uint128_t& value)
+   {
+      ds.read(reinterpret_cast <char*>(&value), sizeof(value));
+      return ds;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const name& value)
+   {
+      return ds << value.value;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, name& value)
+   {
+      return ds >> value.value;
+   }
+
+   template <typename Stream>
+   void write_size(datastream <Stream>& ds, uint64_t size)
+   {
+      do {
+         uint8_t byte = size & 0x7F;
+         size >>= 7;
+         byte |= (size > 0) << 7;
+         ds.write(reinterpret_cast <const char*>(&byte), 1);
+      } while (size > 0);
+   }
+
+   template <typename Stream>
+   uint64_t read_size(datastream <Stream>& ds)
+   {
+      uint64_t size = 0;
+      uint8_t byte = 0;
+      uint8_t shift = 0;
+
+      do {
+         ds.read(reinterpret_cast <char*>(&byte), 1);
+         size |= uint64_t(byte & 0x7F) << shift;
+         shift += 7;
+      } while ((byte & 0x80) != 0 && shift < 35);
+
+      return size;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::string& value)
+   {
+      write_size(ds, value.size());
+      ds.write(value.data(), value.size());
+      return ds;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::string& value)
+   {
+      value.resize(read_size(ds));
+      ds.read(value.data(), value.size());
+      return ds;
+   }
+
+   template <typename Stream, typename T>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::vector <T>& value)
+   {
+      write_size(ds, value.size());
+
+      for (const T& element : value) {
+         ds << element;
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename T>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::vector <T>& value)
+   {
+      value.resize(read_size(ds));
+
+      for (T& element : value) {
+         ds >> element;
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename T, size_t N>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::array <T, N>& value)
+   {
+      for (const T& element : value) {
+         ds << element;
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename T, size_t N>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::array <T, N>& value)
+   {
+      for (T& element : value) {
+         ds >> element;
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename T>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::optional <T>& value)
+   {
+      ds << value.has_value();
+
+      if (value.has_value()) {
+         ds << *value;
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename T>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::optional <T>& value)
+   {
+      bool has_value = false;
+      ds >> has_value;
+
+      if (has_value) {
+         T element;
+         ds >> element;
+         value = std::move(element);
+      } else {
+         value.reset();
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename A, typename B>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::pair <A, B>& value)
+   {
+      return ds << value.first << value.second;
+   }
+
+   template <typename Stream, typename A, typename B>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::pair <A, B>& value)
+   {
+      return ds >> value.first >> value.second;
+   }
+
+   template <typename Stream, typename... T>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::tuple <T...>& value)
+   {
+      std::apply([&](const auto&... element) { (ds << ... << element); }, value);
+      return ds;
+   }
+
+   template <typename Stream, typename... T>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::tuple <T...>& value)
+   {
+      std::apply([&](auto&... element) { (ds >> ... >> element); }, value);
+      return ds;
+   }
+
+   template <typename Stream, typename K, typename V>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const std::map <K, V>& value)
+   {
+      write_size(ds, value.size());
+
+      for (const auto& element : value) {
+         ds << element.first << element.second;
+      }
+
+      return ds;
+   }
+
+   template <typename Stream, typename K, typename V>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, std::map <K, V>& value)
+   {
+      value.clear();
+
+      for (uint64_t size = read_size(ds); size > 0; size--) {
+         K key;
+         V element;
+         ds >> key >> element;
+         value.emplace(std::move(key), std::move(element));
+      }
+
+      return ds;
+   }
+
+   // structs are their fields in declaration order, as the abi generator lays out tables
+   template <typename Stream, typename T, std::enable_if_t <reflect::is_reflected <T>, int> = 0>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const T& value)
+   {
+      reflect::for_each_field(value, [&](const auto& field) { ds << field; });
+      return ds;
+   }
+
+   template <typename Stream, typename T, std::enable_if_t <reflect::is_reflected <T>, int> = 0>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, T& value)
+   {
+      reflect::for_each_field(value, [&](auto& field) { ds >> field; });
+      return ds;
+   }
+
+   template <typename T>
+   size_t pack_size(const T& value)
+   {
+      datastream <size_t> ds;
+      ds << value;
+      return ds.tellp();
+   }
+
+   template <typename T>
+   std::vector <char> pack(const T& value)
+   {
+      std::vector <char> bytes(pack_size(value));
+
+      if (!bytes.empty()) {
+         datastream <char*> ds(bytes.data(), bytes.size());
+         ds << value;
+      }
+
+      return bytes;
+   }
+
+   template <typename T>
+   T unpack(const char* data, size_t size)
+   {
+      T value{};
+      datastream <const char*> ds(data, size);
+      ds >> value;
+      return value;
+   }
+
+   template <typename T>
+   T unpack(const std::vector <char>& bytes)
+   {
+      return unpack <T>(bytes.data(), bytes.size());
+   }
+}
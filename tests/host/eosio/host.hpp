@@ -0,0 +1,223 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <eosio/datastream.hpp>
+#include <eosio/name.hpp>
+
+namespace eosio {
+
+   struct permission_level {
+
+      name actor;
+      name permission;
+
+      friend bool operator==(const permission_level& a, const permission_level& b) { return a.actor == b.actor && a.permission == b.permission; }
+      friend bool operator!=(const permission_level& a, const permission_level& b) { return !(a == b); }
+   };
+
+   // chain state the stand-in headers run against: the tables, the clock, the authorizations of the
+   // running action and the inline actions it sent. Writes are journaled so a failed action is rolled back
+   namespace host {
+
+      struct table_key {
+
+         uint64_t code;
+         uint64_t scope;
+         uint64_t table;
+
+         friend bool operator<(const table_key& a, const table_key& b)
+         {
+            return std::tie(a.code, a.scope, a.table) < std::tie(b.code, b.scope, b.table);
+         }
+      };
+
+      struct row {
+
+         std::vector <char> data;
+         std::vector <uint128_t> keys; // secondary keys, one per index
+      };
+
+      struct table {
+
+         std::map <uint64_t, row> rows;
+         std::vector <std::set <std::pair <uint128_t, uint64_t>>> indices;
+      };
+
+      // database work, what the chain bills an action for besides its own instructions
+      struct counters {
+
+         uint64_t finds = 0; // lookups by key and index positioning
+         uint64_t steps = 0; // iterator moves
+         uint64_t reads = 0; // rows unpacked
+         uint64_t bytes_read = 0;
+         uint64_t writes = 0; // rows stored or updated
+         uint64_t bytes_written = 0;
+         uint64_t erases = 0;
+
+         counters operator-(const counters& other) const
+         {
+            return counters{
+               finds - other.finds, steps - other.steps, reads - other.reads, bytes_read - other.bytes_read,
+               writes - other.writes, bytes_written - other.bytes_written, erases - other.erases
+            };
+         }
+      };
+
+      struct sent_action {
+
+         std::vector <permission_level> authorization;
+         eosio::name account;
+         eosio::name name;
+         std::any data;
+      };
+
+      struct state_t {
+
+         std::map <table_key, table> tables;
+
+         // rows as they were before the running transaction changed them, no value for rows it created
+         std::vector <std::tuple <table_key, uint64_t, std::optional <row>>> journal;
+         bool journaling = false;
+
+         counters work;
+
+         int64_t now = 0; // microseconds
+         std::vector <permission_level> auths;
+         std::vector <sent_action> sent;
+      };
+
+      inline state_t& state()
+      {
+         static state_t s;
+         return s;
+      }
+
+      inline const table* find_table(const table_key& key)
+      {
+         auto itr = state().tables.find(key);
+         return itr == state().tables.end() ? nullptr : &itr->second;
+      }
+
+      inline table& get_table(const table_key& key, size_t index_count)
+      {
+         table& tbl = state().tables[key];
+
+         if (tbl.indices.size() < index_count) {
+            tbl.indices.resize(index_count);
+         }
+
+         return tbl;
+      }
+
+      inline void journal(const table_key& key, const table& tbl, uint64_t pk)
+      {
+         if (!state().journaling) {
+            return;
+         }
+
+         auto itr = tbl.rows.find(pk);
+         state().journal.emplace_back(key, pk, itr == tbl.rows.end() ? std::nullopt : std::optional <row>(itr->second));
+      }
+
+      inline void unlink(table& tbl, uint64_t pk, const row& r)
+      {
+         for (size_t i = 0; i < r.keys.size(); i++) {
+            tbl.indices[i].erase({r.keys[i], pk});
+         }
+      }
+
+      inline void link(table& tbl, uint64_t pk, const row& r)
+      {
+         if (tbl.indices.size() < r.keys.size()) {
+            tbl.indices.resize(r.keys.size());
+         }
+
+         for (size_t i = 0; i < r.keys.size(); i++) {
+            tbl.indices[i].insert({r.keys[i], pk});
+         }
+      }
+
+      inline void store(const table_key& key, table& tbl, uint64_t pk, row r)
+      {
+         journal(key, tbl, pk);
+
+         auto itr = tbl.rows.find(pk);
+
+         if (itr != tbl.rows.end()) {
+            unlink(tbl, pk, itr->second);
+         }
+
+         link(tbl, pk, r);
+
+         state().work.writes++;
+         state().work.bytes_written += r.data.size();
+
+         tbl.rows[pk] = std::move(r);
+      }
+
+      inline void remove(const table_key& key, table& tbl, uint64_t pk)
+      {
+         journal(key, tbl, pk);
+
+         auto itr = tbl.rows.find(pk);
+
+         if (itr != tbl.rows.end()) {
+            unlink(tbl, pk, itr->second);
+            tbl.rows.erase(itr);
+         }
+
+         state().work.erases++;
+      }
+
+      inline void begin()
+      {
+         state().journal.clear();
+         state().journaling = true;
+      }
+
+      inline void commit()
+      {
+         state().journal.clear();
+         state().journaling = false;
+      }
+
+      inline void rollback(size_t sent_before)
+      {
+         auto& journal = state().journal;
+
+         for (auto itr = journal.rbegin(); itr != journal.rend(); ++itr) {
+            auto& [key, pk, old] = *itr;
+            table& tbl = state().tables[key];
+
+            auto row_itr = tbl.rows.find(pk);
+
+            if (row_itr != tbl.rows.end()) {
+               unlink(tbl, pk, row_itr->second);
+               tbl.rows.erase(row_itr);
+            }
+
+            if (old.has_value()) {
+               link(tbl, pk, *old);
+               tbl.rows[pk] = std::move(*old);
+            }
+         }
+
+         state().sent.resize(sent_before);
+         commit();
+      }
+
+      // clears every table, the clock and the logs
+      inline void reset()
+      {
+         state() = state_t();
+      }
+   }
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <eosio/check.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/host.hpp>
+#include <eosio/name.hpp>
+
+namespace eosio {
+
+   template <class Class, class Type, Type (Class::*PtrToMemberFunction)() const>
+   struct const_mem_fun {
+
+      typedef typename std::remove_reference <Type>::type result_type;
+
+      result_type operator()(const Class& x) const { return (x.*PtrToMemberFunction)(); }
+   };
+
+   template <name::raw IndexName, typename Extractor>
+   struct indexed_by {
+
+      static constexpr name::raw index_name = IndexName;
+
+      typedef Extractor secondary_extractor_type;
+   };
+
+   // rows are unpacked once per instance and kept until the instance goes away, like the cdt does.
+   // Every database call is counted in host::state().work
+   template <name::raw TableName, typename T, typename... Indices>
+   class multi_index {
+
+      private:
+
+         static constexpr size_t index_count = sizeof...(Indices);
+
+         typedef std::set <std::pair <uint128_t, uint64_t>> index_set;
+
+         name _code;
+         uint64_t _scope;
+
+         mutable std::map <uint64_t, std::unique_ptr <T>> _cache;
+
+         host::table_key key() const { return host::table_key{_code.value, _scope, static_cast <uint64_t>(TableName)}; }
+
+         const std::map <uint64_t, host::row>& rows() const
+         {
+            static const std::map <uint64_t, host::row> empty;
+            const host::table* tbl = host::find_table(key());
+            return tbl == nullptr ? empty : tbl->rows;
+         }
+
+         const index_set& secondary(size_t i) const
+         {
+            static const index_set empty;
+            const host::table* tbl = host::find_table(key());
+            return tbl == nullptr || tbl->indices.size() <= i ? empty : tbl->indices[i];
+         }
+
+         static std::vector <uint128_t> keys_of(const T& obj)
+         {
+            return std::vector <uint128_t>{static_cast <uint128_t>(typename Indices::secondary_extractor_type()(obj))...};
+         }
+
+         const T* load(uint64_t pk) const
+         {
+            auto cached = _cache.find(pk);
+
+            if (cached != _cache.end()) {
+               return cached->second.get();
+            }
+
+            const host::row& r = rows().at(pk);
+
+            host::state().work.reads++;
+            host::state().work.bytes_read += r.data.size();
+
+            auto obj = std::make_unique <T>(unpack <T>(r.data));
+            const T* ptr = obj.get();
+            _cache.emplace(pk, std::move(obj));
+
+            return ptr;
+         }
+
+         const T* cached(const T& obj, const char* msg) const
+         {
+            auto itr = _cache.find(obj.primary_key());
+            check(itr != _cache.end() && itr->second.get() == &obj, msg);
+            return &obj;
+         }
+
+         void store(const T& obj)
+         {
+            host::table& tbl = host::get_table(key(), index_count);
+            host::store(key(), tbl, obj.primary_key(), host::row{pack(obj), keys_of(obj)});
+         }
+
+         template <name::raw IndexName>
+         static constexpr size_t index_position()
+         {
+            constexpr std::array <name::raw, sizeof...(Indices)> names = {Indices::index_name...};
+
+            for (size_t i = 0; i < names.size(); i++) {
+               if (names[i] == IndexName) {
+                  return i;
+               }
+            }
+
+            return names.size();
+         }
+
+      public:
+
+         class const_iterator {
+
+            public:
+
+               typedef std::bidirectional_iterator_tag iterator_category;
+               typedef T value_type;
+               typedef std::ptrdiff_t difference_type;
+               typedef const T* pointer;
+               typedef const T& reference;
+
+               const_iterator() = default;
+
+               const T& operator*() const
+               {
+                  check(_item != nullptr, "cannot dereference end iterator");
+                  return *_item;
+               }
+
+               const T* operator->() const
+               {
+                  check(_item != nullptr, "cannot dereference end iterator");
+                  return _item;
+               }
+
+               const_iterator& operator++()
+               {
+                  check(_item != nullptr, "cannot increment end iterator");
+
+                  host::state().work.steps++;
+
+                  const auto& rows = _mi->rows();
+                  auto itr = rows.upper_bound(_item->primary_key());
+                  _item = itr == rows.end() ? nullptr : _mi->load(itr->first);
+
+                  return *this;
+               }
+
+               const_iterator& operator--()
+               {
+                  host::state().work.steps++;
+
+                  const auto& rows = _mi->rows();
+                  auto itr = _item == nullptr ? rows.end() : rows.lower_bound(_item->primary_key());
+
+                  check(itr != rows.begin(), _item == nullptr ? "cannot decrement end iterator when the table is empty" : "cannot decrement iterator at beginning of table");
+
+                  _item = _mi->load((--itr)->first);
+
+                  return *this;
+               }
+
+               const_iterator operator++(int)
+               {
+                  const_iterator itr = *this;
+                  ++(*this);
+                  return itr;
+               }
+
+               const_iterator operator--(int)
+               {
+                  const_iterator itr = *this;
+                  --(*this);
+                  return itr;
+               }
+
+               friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._item == b._item; }
+               friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._item != b._item; }
+
+            private:
+
+               friend class multi_index;
+
+               const_iterator(const multi_index* mi, const T* item) : _mi(mi), _item(item) {}
+
+               const multi_index* _mi = nullptr;
+               const T* _item = nullptr;
+         };
+
+         typedef std::reverse_iterator <const_iterator> const_reverse_iterator;
+
+         // secondary index I, ordered by (key, primary key)
+         template <size_t I, typename Extractor>
+         class index {
+
+            public:
+
+               typedef typename Extractor::result_type secondary_key_type;
+
+               class const_iterator {
+
+                  public:
+
+                     typedef std::bidirectional_iterator_tag iterator_category;
+                     typedef T value_type;
+                     typedef std::ptrdiff_t difference_type;
+                     typedef const T* pointer;
+                     typedef const T& reference;
+
+                     const_iterator() = default;
+
+                     const T& operator*() const
+                     {
+                        check(_item != nullptr, "cannot dereference end iterator");
+                        return *_item;
+                     }
+
+                     const T* operator->() const
+                     {
+                        check(_item != nullptr, "cannot dereference end iterator");
+                        return _item;
+                     }
+
+                     const_iterator& operator++()
+                     {
+                        check(_item != nullptr, "cannot increment end iterator");
+
+                        host::state().work.steps++;
+
+                        const index_set& keys = _mi->secondary(I);
+                        auto itr = keys.upper_bound({key_of(*_item), _item->primary_key()});
+                        _item = itr == keys.end() ? nullptr : _mi->load(itr->second);
+
+                        return *this;
+                     }
+
+                     const_iterator& operator--()
+                     {
+                        host::state().work.steps++;
+
+                        const index_set& keys = _mi->secondary(I);
+                        auto itr = _item == nullptr ? keys.end() : keys.lower_bound({key_of(*_item), _item->primary_key()});
+
+                        check(itr != keys.begin(), _item == nullptr ? "cannot decrement end iterator when the index is empty" : "cannot decrement iterator at beginning of index");
+
+                        _item = _mi->load((--itr)->second);
+
+                        return *this;
+                     }
+
+                     const_iterator operator++(int)
+                     {
+                        const_iterator itr = *this;
+                        ++(*this);
+                        return itr;
+                     }
+
+                     const_iterator operator--(int)
+                     {
+                        const_iterator itr = *this;
+                        --(*this);
+                        return itr;
+                     }
+
+                     friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._item == b._item; }
+                     friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._item != b._item; }
+
+                  private:
+
+                     friend class index;
+
+                     const_iterator(const multi_index* mi, const T* item) : _mi(mi), _item(item) {}
+
+                     const multi_index* _mi = nullptr;
+                     const T* _item = nullptr;
+               };
+
+               typedef std::reverse_iterator <const_iterator> const_reverse_iterator;
+
+               explicit index(multi_index* mi) : _mi(mi) {}
+
+               const_iterator begin() const { return lower_position(_mi->secondary(I).begin()); }
+
+               const_iterator cbegin() const { return begin(); }
+
+               const_iterator end() const { return const_iterator(_mi, nullptr); }
+
+               const_iterator cend() const { return end(); }
+
+               const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+
+               const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+               const_iterator lower_bound(secondary_key_type secondary) const
+               {
+                  return lower_position(_mi->secondary(I).lower_bound({static_cast <uint128_t>(secondary), 0}));
+               }
+
+               const_iterator upper_bound(secondary_key_type secondary) const
+               {
+                  return lower_position(_mi->secondary(I).upper_bound({static_cast <uint128_t>(secondary), std::numeric_limits <uint64_t>::max()}));
+               }
+
+               const_iterator find(secondary_key_type secondary) const
+               {
+                  const_iterator itr = lower_bound(secondary);
+                  return itr != end() && key_of(*itr) == static_cast <uint128_t>(secondary) ? itr : end();
+               }
+
+               const_iterator require_find(secondary_key_type secondary, const char* error_msg = "unable to find secondary key") const
+               {
+                  const_iterator itr = find(secondary);
+                  check(itr != end(), error_msg);
+                  return itr;
+               }
+
+               const T& get(secondary_key_type secondary, const char* error_msg = "unable to find secondary key") const
+               {
+                  return *require_find(secondary, error_msg);
+               }
+
+               const_iterator iterator_to(const T& obj) const
+               {
+                  return const_iterator(_mi, _mi->cached(obj, "object passed to iterator_to is not in multi_index"));
+               }
+
+               template <typename Lambda>
+               void modify(const_iterator itr, name payer, Lambda&& updater)
+               {
+                  check(itr != end(), "cannot pass end iterator to modify");
+                  _mi->modify(*itr, payer, std::forward <Lambda>(updater));
+               }
+
+               const_iterator erase(const_iterator itr)
+               {
+                  check(itr != end(), "cannot pass end iterator to erase");
+
+                  const_iterator next = itr;
+                  ++next;
+
+                  _mi->erase(*itr);
+
+                  return next;
+               }
+
+               static uint128_t key_of(const T& obj) { return static_cast <uint128_t>(Extractor()(obj)); }
+
+            private:
+
+               const_iterator lower_position(typename index_set::const_iterator itr) const
+               {
+                  host::state().work.finds++;
+                  return const_iterator(_mi, itr == _mi->secondary(I).end() ? nullptr : _mi->load(itr->second));
+               }
+
+               multi_index* _mi;
+         };
+
+         multi_index(name code, uint64_t scope) : _code(code), _scope(scope) {}
+
+         multi_index(const multi_index&) = delete;
+         multi_index& operator=(const multi_index&) = delete;
+
+         name get_code() const { return _code; }
+
+         uint64_t get_scope() const { return _scope; }
+
+         const_iterator begin() const { return position(rows().begin()); }
+
+         const_iterator cbegin() const { return begin(); }
+
+         const_iterator end() const { return const_iterator(this, nullptr); }
+
+         const_iterator cend() const { return end(); }
+
+         const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+
+         const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+         const_iterator lower_bound(uint64_t primary) const { return position(rows().lower_bound(primary)); }
+
+         const_iterator upper_bound(uint64_t primary) const { return position(rows().upper_bound(primary)); }
+
+         // rows already unpacked by this instance are found without a database call
+         const_iterator find(uint64_t primary) const
+         {
+            auto cached = _cache.find(primary);
+
+            if (cached != _cache.end()) {
+               return const_iterator(this, cached->second.get());
+            }
+
+            host::state().work.finds++;
+
+            const auto& rows = this->rows();
+            return const_iterator(this, rows.find(primary) == rows.end() ? nullptr : load(primary));
+         }
+
+         const_iterator require_find(uint64_t primary, const char* error_msg = "unable to find key") const
+         {
+            const_iterator itr = find(primary);
+            check(itr != end(), error_msg);
+            return itr;
+         }
+
+         const T& get(uint64_t primary, const char* error_msg = "unable to find key") const
+         {
+            return *require_find(primary, error_msg);
+         }
+
+         uint64_t available_primary_key() const
+         {
+            host::state().work.finds++;
+
+            const auto& rows = this->rows();
+            return rows.empty() ? 0 : rows.rbegin()->first + 1;
+         }
+
+         const_iterator iterator_to(const T& obj) const
+         {
+            return const_iterator(this, cached(obj, "object passed to iterator_to is not in multi_index"));
+         }
+
+         template <typename Lambda>
+         const_iterator emplace(name payer, Lambda&& constructor)
+         {
+            auto obj = std::make_unique <T>();
+            constructor(*obj);
+
+            uint64_t pk = obj->primary_key();
+
+            check(rows().count(pk) == 0, "could not insert object, most likely a uniqueness constraint was violated");
+
+            store(*obj);
+
+            const T* ptr = obj.get();
+            _cache[pk] = std::move(obj);
+
+            return const_iterator(this, ptr);
+         }
+
+         template <typename Lambda>
+         void modify(const_iterator itr, name payer, Lambda&& updater)
+         {
+            check(itr != end(), "cannot pass end iterator to modify");
+            modify(*itr, payer, std::forward <Lambda>(updater));
+         }
+
+         template <typename Lambda>
+         void modify(const T& obj, name payer, Lambda&& updater)
+         {
+            T& mutable_obj = const_cast <T&>(*cached(obj, "object passed to modify is not in multi_index"));
+
+            uint64_t pk = mutable_obj.primary_key();
+
+            updater(mutable_obj);
+
+            check(pk == mutable_obj.primary_key(), "updater cannot change primary key when modifying an object");
+
+            store(mutable_obj);
+         }
+
+         const_iterator erase(const_iterator itr)
+         {
+            check(itr != end(), "cannot pass end iterator to erase");
+
+            const_iterator next = itr;
+            ++next;
+
+            erase(*itr);
+
+            return next;
+         }
+
+         void erase(const T& obj)
+         {
+            uint64_t pk = cached(obj, "object passed to erase is not in multi_index")->primary_key();
+
+            host::remove(key(), host::get_table(key(), index_count), pk);
+
+            _cache.erase(pk);
+         }
+
+         template <name::raw IndexName>
+         auto get_index() const
+         {
+            constexpr size_t position = index_position <IndexName>();
+            static_assert(position < index_count, "name provided is not the name of any secondary index within multi_index");
+
+            typedef typename std::tuple_element_t <position, std::tuple <Indices...>>::secondary_extractor_type extractor;
+
+            return index <position, extractor>(const_cast <multi_index*>(this));
+         }
+
+      private:
+
+         const_iterator position(typename std::map <uint64_t, host::row>::const_iterator itr) const
+         {
+            host::state().work.finds++;
+            return const_iterator(this, itr == rows().end() ? nullptr : load(itr->first));
+         }
+   };
+}
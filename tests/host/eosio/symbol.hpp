@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <eosio/check.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/name.hpp>
+
+namespace eosio {
+
+   // up to 7 upper case letters, packed little endian like on chain
+   class symbol_code {
+
+      public:
+
+         constexpr symbol_code() = default;
+
+         constexpr explicit symbol_code(uint64_t raw) : value(raw) {}
+
+         constexpr explicit symbol_code(std::string_view str)
+         {
+            if (str.size() > 7) {
+               check(false, "string is too long to be a valid symbol_code");
+            }
+
+            for (auto it = str.rbegin(); it != str.rend(); ++it) {
+               if (*it < 'A' || *it > 'Z') {
+                  check(false, "only uppercase letters allowed in symbol_code string");
+               }
+
+               value <<= 8;
+               value |= *it;
+            }
+         }
+
+         constexpr bool is_valid() const
+         {
+            uint64_t sym = value;
+
+            for (int i = 0; i < 7; i++) {
+               char c = (char) (sym & 0xFF);
+
+               if (!('A' <= c && c <= 'Z')) {
+                  return false;
+               }
+
+               sym >>= 8;
+
+               if (!(sym & 0xFF)) {
+                  do {
+                     sym >>= 8;
+
+                     if ((sym & 0xFF)) {
+                        return false;
+                     }
+
+                     i++;
+                  } while (i < 7);
+               }
+            }
+
+            return true;
+         }
+
+         constexpr uint64_t raw() const { return value; }
+
+         std::string to_string() const
+         {
+            std::string str;
+
+            for (uint64_t sym = value; sym > 0; sym >>= 8) {
+               str += (char) (sym & 0xFF);
+            }
+
+            return str;
+         }
+
+         friend constexpr bool operator==(const symbol_code& a, const symbol_code& b) { return a.value == b.value; }
+         friend constexpr bool operator!=(const symbol_code& a, const symbol_code& b) { return a.value != b.value; }
+         friend constexpr bool operator<(const symbol_code& a, const symbol_code& b) { return a.value < b.value; }
+
+      private:
+
+         uint64_t value = 0;
+   };
+
+   // symbol code and precision, code << 8 | precision
+   class symbol {
+
+      public:
+
+         constexpr symbol() = default;
+
+         constexpr explicit symbol(uint64_t raw) : value(raw) {}
+
+         constexpr symbol(symbol_code sc, uint8_t precision) : value(sc.raw() << 8 | precision) {}
+
+         constexpr symbol(std::string_view str, uint8_t precision) : value(symbol_code(str).raw() << 8 | precision) {}
+
+         constexpr bool is_valid() const { return code().is_valid(); }
+
+         constexpr uint8_t precision() const { return (uint8_t) (value & 0xFF); }
+
+         constexpr symbol_code code() const { return symbol_code(value >> 8); }
+
+         constexpr uint64_t raw() const { return value; }
+
+         constexpr explicit operator bool() const { return value != 0; }
+
+         std::string to_string() const { return std::to_string(precision()) + "," + code().to_string(); }
+
+         friend constexpr bool operator==(const symbol& a, const symbol& b) { return a.value == b.value; }
+         friend constexpr bool operator!=(const symbol& a, const symbol& b) { return a.value != b.value; }
+         friend constexpr bool operator<(const symbol& a, const symbol& b) { return a.value < b.value; }
+
+      private:
+
+         uint64_t value = 0;
+   };
+
+   // symbol and the token contract issuing it
+   class extended_symbol {
+
+      public:
+
+         extended_symbol() = default;
+
+         extended_symbol(symbol s, name con) : sym(s), contract(con) {}
+
+         symbol get_symbol() const { return sym; }
+
+         name get_contract() const { return contract; }
+
+         std::string to_string() const { return sym.to_string() + "@" + contract.to_string(); }
+
+         friend bool operator==(const extended_symbol& a, const extended_symbol& b) { return a.sym == b.sym && a.contract == b.contract; }
+         friend bool operator!=(const extended_symbol& a, const extended_symbol& b) { return !(a == b); }
+         friend bool operator<(const extended_symbol& a, const extended_symbol& b) { return a.contract < b.contract || (a.contract == b.contract && a.sym < b.sym); }
+
+         template <typename Stream>
+         friend datastream <Stream>& operator<<(datastream <Stream>& ds, const extended_symbol& value)
+         {
+            return ds << value.sym.raw() << value.contract;
+         }
+
+         template <typename Stream>
+         friend datastream <Stream>& operator>>(datastream <Stream>& ds, extended_symbol& value)
+         {
+            uint64_t raw = 0;
+            ds >> raw >> value.contract;
+            value.sym = symbol(raw);
+            return ds;
+         }
+
+      private:
+
+         symbol sym;
+         name contract;
+   };
+
+   template <typename Stream>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const symbol_code& value)
+   {
+      return ds << value.raw();
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, symbol_code& value)
+   {
+      uint64_t raw = 0;
+      ds >> raw;
+      value = symbol_code(raw);
+      return ds;
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator<<(datastream <Stream>& ds, const symbol& value)
+   {
+      return ds << value.raw();
+   }
+
+   template <typename Stream>
+   datastream <Stream>& operator>>(datastream <Stream>& ds, symbol& value)
+   {
+      uint64_t raw = 0;
+      ds >> raw;
+      value = symbol(raw);
+      return ds;
+   }
+}
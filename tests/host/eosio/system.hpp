@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include <eosio/host.hpp>
+
+namespace eosio {
+
+   class microseconds {
+
+      public:
+
+         explicit microseconds(int64_t c = 0) : _count(c) {}
+
+         int64_t count() const { return _count; }
+
+         int64_t to_seconds() const { return _count / 1000000; }
+
+      private:
+
+         int64_t _count;
+   };
+
+   class time_point {
+
+      public:
+
+         explicit time_point(microseconds e = microseconds()) : elapsed(e) {}
+
+         const microseconds& time_since_epoch() const { return elapsed; }
+
+         uint32_t sec_since_epoch() const { return uint32_t(elapsed.count() / 1000000); }
+
+      private:
+
+         microseconds elapsed;
+   };
+
+   class time_point_sec {
+
+      public:
+
+         time_point_sec() = default;
+
+         explicit time_point_sec(uint32_t seconds) : utc_seconds(seconds) {}
+
+         time_point_sec(const time_point& t) : utc_seconds(t.sec_since_epoch()) {}
+
+         uint32_t sec_since_epoch() const { return utc_seconds; }
+
+      private:
+
+         uint32_t utc_seconds = 0;
+   };
+
+   // time of the running action, set by the tester
+   inline time_point current_time_point()
+   {
+      return time_point(microseconds(host::state().now));
+   }
+}
@@ -0,0 +1,430 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <clashdometrn.hpp>
+#include <eosio/singleton.hpp>
+
+// runs clashdometrn actions natively against the host stand-in of the cdt headers, see tests/host
+namespace clashdome_test {
+
+   using namespace eosio;
+
+   static constexpr name SELF = name("clashdometrn");
+   static constexpr name PAY = name("clashdomepay");
+   static constexpr name TOKEN_CONTRACT = name("alien.worlds");
+   static constexpr symbol TLM = symbol(symbol_code("TLM"), 4);
+
+   // 2023-11-14, tournaments are created relative to it
+   static constexpr uint32_t START_TIME = 1700000000;
+
+   inline asset tlm(int64_t amount) { return asset(amount, TLM); }
+
+   inline permission_level active(name account) { return permission_level{account, name("active")}; }
+
+   // mirrors of the contract tables, which are private to the contract. The layouts have to match
+   struct round_row {
+      uint32_t entries;
+      asset collected;
+      asset pot;
+      uint32_t ranked;
+      uint8_t status;
+      uint32_t winners;
+      uint32_t paid;
+      asset distributed;
+   };
+
+   struct config_row {
+      uint64_t tournament_counter;
+      std::vector <extended_symbol> supported_tokens_fee;
+      std::vector <extended_symbol> supported_tokens_stake;
+   };
+
+   struct nft_requirement_row {
+      name collection;
+      name schema;
+      int32_t template_id;
+      uint8_t count;
+   };
+
+   struct tournament_row {
+      uint64_t tournament_id;
+      name creator;
+      std::string trn_name; // name in the contract, renamed so it doesn't shadow eosio::name
+      uint8_t version;
+      uint8_t game;
+      uint8_t type_prize_pot;
+      bool recreate;
+      uint32_t timestamp_start;
+      uint32_t timestamp_end;
+      asset prize_pot;
+      std::optional <asset> requeriment_fee;
+      std::optional <asset> requeriment_stake;
+      std::optional <nft_requirement_row> requeriment_nft;
+      binary_extension <round_row> round;
+      binary_extension <uint64_t> name_ref;
+      binary_extension <name> pot_contract;
+
+      uint64_t primary_key() const { return tournament_id; }
+   };
+
+   struct legacy_tournament_row {
+      uint64_t tournament_id;
+      name creator;
+      std::string trn_name;
+      uint64_t game;
+      uint64_t timestamp_start;
+      uint64_t timestamp_end;
+      asset requeriment_fee;
+      asset requeriment_stake;
+      std::string requeriment_nft;
+      asset prize_pot;
+      std::string type_prize_pot;
+      bool recreate;
+
+      uint64_t primary_key() const { return tournament_id; }
+      uint64_t by_creator() const { return creator.value; }
+      uint64_t by_start_time() const { return timestamp_start; }
+      uint128_t by_creator_game_end() const { return ((uint128_t) creator.value << 64) | ((game & 0xFFFFFFFF) << 32) | (timestamp_end & 0xFFFFFFFF); }
+   };
+
+   // the legacy tournaments table read by migratetrn, with the indices the contract looks up
+   typedef multi_index <name("tournaments"), legacy_tournament_row,
+      indexed_by <name("bycreator"), const_mem_fun <legacy_tournament_row, uint64_t, &legacy_tournament_row::by_creator>>,
+      indexed_by <name("bystarttime"), const_mem_fun <legacy_tournament_row, uint64_t, &legacy_tournament_row::by_start_time>>,
+      indexed_by <name("bycrgameend"), const_mem_fun <legacy_tournament_row, uint128_t, &legacy_tournament_row::by_creator_game_end>>>
+   legacy_tournaments_table;
+
+   struct creator_row {
+      eosio::name creator;
+      std::string img;
+      std::vector <extended_symbol> supported_tokens_fee;
+      bool stake_available;
+      std::vector <extended_symbol> supported_tokens_stake;
+      bool nft_available;
+      bool pot_available;
+      std::vector <asset> funds;
+      binary_extension <uint64_t> img_ref;
+
+      uint64_t primary_key() const { return creator.value; }
+   };
+
+   struct string_row {
+      uint64_t id;
+      std::string value;
+      uint32_t refs;
+
+      uint64_t primary_key() const { return id; }
+   };
+
+   struct scan_row {
+      name scan;
+      uint64_t scope;
+      uint32_t timestamp_start;
+      uint64_t tournament_id;
+
+      uint64_t primary_key() const { return scan.value; }
+   };
+
+   struct balance_row {
+      asset funds;
+      binary_extension <name> contract;
+
+      uint64_t primary_key() const { return funds.symbol.code().raw(); }
+   };
+
+   struct sweep_row {
+      extended_symbol token;
+      asset pending;
+      asset swept;
+      asset deposited;
+      asset threshold;
+      asset paid;
+
+      uint64_t primary_key() const { return token.get_symbol().raw(); }
+   };
+
+   struct token_row {
+      extended_symbol token;
+      uint8_t type;
+
+      uint64_t primary_key() const { return token.get_symbol().raw(); }
+   };
+
+   struct result_row {
+      uint32_t round_start;
+      checksum256 root;
+      extended_asset total;
+      asset claimed;
+      name creator;
+      uint32_t expires;
+
+      uint64_t primary_key() const { return round_start; }
+   };
+
+   struct claim_row {
+      uint64_t word;
+      uint64_t bits;
+
+      uint64_t primary_key() const { return word; }
+   };
+
+   struct modlog_row {
+      uint64_t sequence;
+      name account;
+      uint64_t timestamp;
+      std::string type;
+
+      uint64_t primary_key() const { return sequence; }
+   };
+
+   struct trngame_row {
+      uint64_t tournament_id;
+      uint8_t game;
+
+      uint64_t primary_key() const { return tournament_id; }
+   };
+
+   struct entry_row {
+      name account;
+      uint32_t round_start;
+      uint32_t timestamp;
+      asset fee;
+
+      uint64_t primary_key() const { return account.value; }
+   };
+
+   struct nftlock_row {
+      uint64_t asset_id;
+      name account;
+      uint32_t round_start;
+
+      uint64_t primary_key() const { return asset_id; }
+   };
+
+   // leading fields of an atomicassets asset, the only ones the contract reads
+   struct nft_asset_row {
+      uint64_t asset_id;
+      name collection_name;
+      name schema_name;
+      int32_t template_id;
+
+      uint64_t primary_key() const { return asset_id; }
+   };
+
+   struct purge_row {
+      name creator;
+      uint8_t stage;
+      uint64_t cursor;
+
+      uint64_t primary_key() const { return creator.value; }
+   };
+
+   // every row of a table scope, in primary key order
+   template <name::raw TableName, typename Row>
+   std::vector <Row> rows(name code, uint64_t scope)
+   {
+      multi_index <TableName, Row> table(code, scope);
+      return std::vector <Row>(table.begin(), table.end());
+   }
+
+   template <name::raw TableName, typename Row>
+   std::optional <Row> row(name code, uint64_t scope, uint64_t primary)
+   {
+      multi_index <TableName, Row> table(code, scope);
+      auto itr = table.find(primary);
+      return itr == table.end() ? std::nullopt : std::optional <Row>(*itr);
+   }
+
+   // chain of one contract: every action runs in its own transaction, rolled back when it fails
+   class tester {
+
+      public:
+
+         tester()
+         {
+            host::reset();
+            set_time(START_TIME);
+         }
+
+         void set_time(uint32_t seconds) { host::state().now = (int64_t) seconds * 1000000; }
+
+         void advance(uint32_t seconds) { set_time(now() + seconds); }
+
+         uint32_t now() const { return uint32_t(host::state().now / 1000000); }
+
+         // runs f(contract) as an action authorized by auths, on a notification when first_receiver isn't the contract
+         template <typename F>
+         auto push(const std::vector <permission_level>& auths, F&& f, name first_receiver = SELF)
+         {
+            host::state().auths = auths;
+            size_t sent = host::state().sent.size();
+
+            host::begin();
+
+            // a failed action is dropped without running the destructor, which would write back its row cache
+            clashdometrn* contract = new clashdometrn(SELF, first_receiver, datastream <const char*>(nullptr, 0));
+
+            try {
+               if constexpr (std::is_void_v <decltype(f(*contract))>) {
+                  f(*contract);
+                  delete contract;
+                  host::commit();
+               } else {
+                  auto result = f(*contract);
+                  delete contract;
+                  host::commit();
+                  return result;
+               }
+            } catch (...) {
+               host::rollback(sent);
+               throw;
+            }
+         }
+
+         // database work and wall time of an action, including the write back of its row cache. 
+         // The action is always rolled back, so it can be measured again on the same tables
+         template <typename F>
+         std::pair <host::counters, double> measure(const std::vector <permission_level>& auths, F&& f, name first_receiver = SELF)
+         {
+            host::state().auths = auths;
+            size_t sent = host::state().sent.size();
+
+            host::begin();
+
+            host::counters before = host::state().work;
+            auto start = std::chrono::steady_clock::now();
+
+            clashdometrn* contract = new clashdometrn(SELF, first_receiver, datastream <const char*>(nullptr, 0));
+
+            try {
+               f(*contract);
+               delete contract;
+            } catch (...) {
+               host::rollback(sent);
+               throw;
+            }
+
+            double micros = std::chrono::duration <double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            host::counters work = host::state().work - before;
+
+            host::rollback(sent);
+
+            return {work, micros};
+         }
+
+         // the message of the check an action fails, empty when it succeeds
+         template <typename F>
+         std::string error(const std::vector <permission_level>& auths, F&& f, name first_receiver = SELF)
+         {
+            try {
+               push(auths, std::forward <F>(f), first_receiver);
+            } catch (const check_failure& e) {
+               return e.what();
+            }
+
+            return "";
+         }
+
+         // contract with TLM as global fee and stake token
+         void init()
+         {
+            push({active(SELF)}, [](clashdometrn& c) {
+               c.initconfig();
+               c.addconftoken(TOKEN_CONTRACT, TLM, "fee");
+            });
+
+            push({active(SELF)}, [](clashdometrn& c) { c.addconftoken(TOKEN_CONTRACT, TLM, "stake"); });
+         }
+
+         void add_creator(name creator, const std::string& img = "img")
+         {
+            push({active(SELF)}, [&](clashdometrn& c) { c.addcreator(creator, img, {}, false, {}, false, true); });
+         }
+
+         // token transfer notification from alien.worlds
+         void transfer(name from, const asset& quantity, const std::string& memo)
+         {
+            push({active(from)}, [&](clashdometrn& c) { c.receive_transfer(from, SELF, quantity, memo); }, TOKEN_CONTRACT);
+         }
+
+         void deposit(name creator, const asset& quantity) { transfer(creator, quantity, "add-funds"); }
+
+         uint64_t create(name creator, const std::string& trn_name, uint64_t game, uint32_t start, uint32_t end, const asset& fee, const asset& pot, bool recreate = false)
+         {
+            uint64_t id = next_id();
+
+            push({active(creator)}, [&](clashdometrn& c) {
+               c.createtrn(creator, trn_name, game, start, end, fee, tlm(0), "", pot, "MINIMUM", recreate);
+            });
+
+            return id;
+         }
+
+         uint64_t next_id()
+         {
+            return singleton <name("config"), config_row>(SELF, SELF.value).get().tournament_counter;
+         }
+
+         // builds with CLASHDOME_GAME_SCOPES keep the tournaments in the scope of their game, see trngames
+         std::optional <tournament_row> tournament(uint64_t id)
+         {
+            uint64_t scope = SELF.value;
+
+#ifdef CLASHDOME_GAME_SCOPES
+            auto dir = row <name("trngames"), trngame_row>(SELF, SELF.value, id);
+
+            if (dir.has_value()) {
+               scope = dir->game;
+            }
+#endif
+
+            return row <name("tournaments2"), tournament_row>(SELF, scope, id);
+         }
+
+         int64_t balance(name creator)
+         {
+            auto bal = row <name("balances"), balance_row>(SELF, creator.value, TLM.code().raw());
+            return bal.has_value() ? bal->funds.amount : 0;
+         }
+
+         bool has_balance_row(name creator) { return row <name("balances"), balance_row>(SELF, creator.value, TLM.code().raw()).has_value(); }
+
+         sweep_row sweep() { return row <name("sweeps"), sweep_row>(SELF, TOKEN_CONTRACT.value, TLM.raw()).value(); }
+
+         const std::vector <host::sent_action>& sent() const { return host::state().sent; }
+
+         // the last inline action of that name sent from from_index on, instrumented builds send logstats after every action
+         const host::sent_action* last_sent(name action, size_t from_index = 0) const
+         {
+            for (size_t i = sent().size(); i > from_index; i--) {
+               if (sent()[i - 1].name == action) {
+                  return &sent()[i - 1];
+               }
+            }
+
+            return nullptr;
+         }
+
+         // transfers of the token contract sent by the last actions, as (from, to, quantity)
+         std::vector <std::tuple <name, name, asset>> transfers(size_t from_index = 0) const
+         {
+            std::vector <std::tuple <name, name, asset>> result;
+
+            for (size_t i = from_index; i < sent().size(); i++) {
+               const host::sent_action& act = sent()[i];
+
+               if (act.account == TOKEN_CONTRACT && act.name == name("transfer")) {
+                  auto [from, to, quantity, memo] = std::any_cast <std::tuple <name, name, asset, std::string>>(act.data);
+                  result.emplace_back(from, to, quantity);
+               }
+            }
+
+            return result;
+         }
+   };
+}